@@ -1,17 +1,49 @@
 #include <algorithm>
 using std::find;
+using std::max;
+using std::min;
 using std::swap;
-#include <array>
-using std::array;
+#include <atomic>
+using std::atomic;
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+using std::condition_variable;
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <fstream>
+using std::ifstream;
+using std::ofstream;
+#include <functional>
+using std::function;
 #include <iostream>
 using std::cout;
 using std::cerr;
+#include <memory>
+using std::unique_ptr;
+#include <mutex>
+using std::mutex;
+using std::unique_lock;
+#include <signal.h>
 #include <sstream>
 using std::ostringstream;
 #include <string>
 using std::string;
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+using std::thread;
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+using std::unordered_map;
 #include <vector>
 using std::vector;
 
@@ -72,12 +104,80 @@ public:
     lChild(_lChild),
     rChild(_rChild)
   {
+    nLive += 1;
+  }
+  GNode(GNode const &) = delete;
+  GNode &operator=(GNode const &) = delete;
+  ~GNode() {
+    delete lChild;
+    delete rChild;
+    nLive -= 1;
+  }
+  static size_t getNLive() { return nLive; }
+  GNode *clone() const {
+    return new GNode(kind, lChild ? lChild->clone() : 0, rChild ? rChild->clone() : 0);
+  }
+  size_t countNodes() const {
+    return 1 + (lChild ? lChild->countNodes() : 0) + (rChild ? rChild->countNodes() : 0);
+  }
+  size_t depth() const {
+    return 1 + max(lChild ? lChild->depth() : 0, rChild ? rChild->depth() : 0);
+  }
+  // Appends the address of every child link in this genome, so that
+  // genetic operators can splice in other subtrees.
+  void collectLinks(vector<GNode **> &links) {
+    if (lChild) {
+      links.push_back(&lChild);
+      lChild->collectLinks(links);
+    }
+    if (rChild) {
+      links.push_back(&rChild);
+      rChild->collectLinks(links);
+    }
+  }
+  void collectNodes(vector<GNode const *> &nodes) const {
+    nodes.push_back(this);
+    if (lChild) {
+      lChild->collectNodes(nodes);
+    }
+    if (rChild) {
+      rChild->collectNodes(nodes);
+    }
   }
   GKind getKind() const { return kind; }
   GNode *getNext() const { if (!isDone()) { return lChild; } return 0; }
   GNode *getSibling() const { return rChild; }
   bool isDone() const { return kind == End; }
   bool hasMore() const { return !isDone(); }
+  // A compact preorder encoding, one byte per node, with EoKind
+  // standing in for a missing child.
+  void serialize(string &bytes) const {
+    bytes.push_back(char(kind));
+    if (kind != End) {
+      if (lChild) {
+	lChild->serialize(bytes);
+      } else {
+	bytes.push_back(char(EoKind));
+      }
+    }
+    if (kind == Ser || kind == Par) {
+      if (rChild) {
+	rChild->serialize(bytes);
+      } else {
+	bytes.push_back(char(EoKind));
+      }
+    }
+  }
+  static GNode *deserialize(char const *&bytes, char const *end) {
+    if (bytes == end || EoKind <= GKind(*bytes)) {
+      bytes += bytes != end;
+      return 0;
+    }
+    GKind kind = GKind(*bytes++);
+    GNode *lChild = kind != End ? deserialize(bytes, end) : 0;
+    GNode *rChild = (kind == Ser || kind == Par) ? deserialize(bytes, end) : 0;
+    return new GNode(kind, lChild, rChild);
+  }
   string toString() const {
     ostringstream s;
     s << ::toString(kind);
@@ -91,11 +191,21 @@ public:
     return s.str();
   }
 private:
+  static size_t nLive;
+
   GKind kind;
   GNode *lChild;
   GNode *rChild;
 };
 
+size_t GNode::nLive = 0;
+
+// A genome is owned through its root; each GNode owns its children.
+// The PNodes of a network developed from a genome only borrow it, so it
+// has to outlive the network, which lasts until the next seedNetwork().
+
+typedef unique_ptr<GNode> Genome;
+
 GNode *GenWait() { return new GNode(Wait); }
 GNode *GenEnd() { return new GNode(End); }
 GNode *GenTInc(GNode *lChild) { return new GNode(TInc, lChild); }
@@ -111,6 +221,208 @@ GNode *GenWDec(GNode *lChild) { return new GNode(WDec, lChild); }
 GNode *GenPar(GNode *lChild, GNode *rChild) { return new GNode(Par, lChild, rChild); }
 GNode *GenSer(GNode *lChild, GNode *rChild) { return new GNode(Ser, lChild, rChild); }
 
+// Bump allocates memory that's only ever released all at once, by
+// Reset(), after which its chunks are handed out again.
+
+class EdgeArena {
+public:
+  EdgeArena(size_t _chunkSize = 1 << 16) : chunkSize(_chunkSize), current(0), used(0) { }
+  ~EdgeArena() {
+    for (auto &c : chunks) {
+      ::operator delete(c.bytes);
+    }
+  }
+  void *allocate(size_t size) {
+    size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    if (current == chunks.size() || chunks[current].size < used + size) {
+      if (current < chunks.size()) {
+	current += 1;
+      }
+      if (current == chunks.size() || chunks[current].size < size) {
+	size_t newSize = max(chunkSize, size);
+	chunks.insert(chunks.begin() + current, { static_cast<char *>(::operator new(newSize)), newSize });
+      }
+      used = 0;
+    }
+    void *p = chunks[current].bytes + used;
+    used += size;
+    return p;
+  }
+  void Reset() {
+    current = 0;
+    used = 0;
+  }
+  // Frees the chunks beyond the one in use.
+  void Trim() {
+    while (current + 1 < chunks.size()) {
+      ::operator delete(chunks.back().bytes);
+      chunks.pop_back();
+    }
+  }
+  size_t getBytesUsed() const {
+    size_t bytes = used;
+    for (size_t c = 0; c < current && c < chunks.size(); c += 1) {
+      bytes += chunks[c].size;
+    }
+    return bytes;
+  }
+  size_t getBytesReserved() const {
+    size_t bytes = 0;
+    for (auto &c : chunks) {
+      bytes += c.size;
+    }
+    return bytes;
+  }
+
+private:
+  struct Chunk {
+    char *bytes;
+    size_t size;
+  };
+
+  size_t chunkSize;
+  vector<Chunk> chunks;
+  size_t current;
+  size_t used;
+};
+
+void *allocateEdges(size_t size);
+
+// A vector for a node's edges, which keeps the first N of them inline
+// in the node itself; longer lists spill into the network pool's edge
+// arena, and live there until it's reset.  Edges are plain pointers and
+// weights, so elements are simply copied, and never destroyed.
+
+template <typename T, size_t N>
+class EdgeList {
+  static_assert(std::is_trivially_copyable<T>::value, "EdgeList elements are copied bytewise");
+
+public:
+  typedef T *iterator;
+  typedef T const *const_iterator;
+
+  EdgeList() : elements(inlineElements()), count(0), capacity(N) { }
+  EdgeList(EdgeList const &) = delete;
+  EdgeList &operator=(EdgeList const &) = delete;
+
+  iterator begin() { return elements; }
+  iterator end() { return elements + count; }
+  const_iterator begin() const { return elements; }
+  const_iterator end() const { return elements + count; }
+  const_iterator cbegin() const { return elements; }
+  const_iterator cend() const { return elements + count; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  T &operator[](size_t i) { return elements[i]; }
+  T const &operator[](size_t i) const { return elements[i]; }
+  T &back() { return elements[count - 1]; }
+  T const &back() const { return elements[count - 1]; }
+
+  void push_back(T const &t) {
+    if (count == capacity) {
+      grow();
+    }
+    new (elements + count) T(t);
+    count += 1;
+  }
+  void pop_back() { count -= 1; }
+  iterator erase(iterator i) {
+    for (iterator j = i; j + 1 != end(); j++) {
+      *j = *(j + 1);
+    }
+    count -= 1;
+    return i;
+  }
+  void clear() { count = 0; }
+
+private:
+  T *inlineElements() { return reinterpret_cast<T *>(inlineStorage); }
+  void grow() {
+    size_t newCapacity = 2 * max(size_t(capacity), N);
+    T *newElements = static_cast<T *>(allocateEdges(newCapacity * sizeof(T)));
+    for (size_t i = 0; i < count; i += 1) {
+      newElements[i] = elements[i];
+    }
+    elements = newElements;
+    capacity = newCapacity;
+  }
+
+  T *elements;
+  uint32_t count;
+  uint32_t capacity;
+  alignas(T) unsigned char inlineStorage[N * sizeof(T)];
+};
+
+// Hands out fixed-size slots from large contiguous chunks, so that nodes
+// created one after another (as development does) sit next to each
+// other, and recycles freed slots.  Reset() forgets every slot at once,
+// without running any destructors, and keeps the chunks for reuse.
+
+class NodePool {
+public:
+  NodePool(size_t _slotSize, size_t _slotsPerChunk = 1024) :
+    slotSize((_slotSize + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1)),
+    slotsPerChunk(_slotsPerChunk),
+    nChunksUsed(0),
+    nextSlot(_slotsPerChunk),
+    freeSlots(0),
+    nLive(0)
+  {
+  }
+  ~NodePool() {
+    for (auto &c : chunks) {
+      ::operator delete(c);
+    }
+  }
+  size_t getSlotSize() const { return slotSize; }
+  size_t getNLive() const { return nLive; }
+  size_t getNChunks() const { return chunks.size(); }
+  size_t getBytesReserved() const { return chunks.size() * slotsPerChunk * slotSize; }
+  void *allocate() {
+    nLive += 1;
+    if (freeSlots) {
+      void *slot = freeSlots;
+      freeSlots = *static_cast<void **>(slot);
+      return slot;
+    }
+    if (nextSlot == slotsPerChunk) {
+      if (nChunksUsed == chunks.size()) {
+	chunks.push_back(static_cast<char *>(::operator new(slotSize * slotsPerChunk)));
+      }
+      nChunksUsed += 1;
+      nextSlot = 0;
+    }
+    return chunks[nChunksUsed - 1] + slotSize * nextSlot++;
+  }
+  void release(void *slot) {
+    nLive -= 1;
+    *static_cast<void **>(slot) = freeSlots;
+    freeSlots = slot;
+  }
+  void Reset() {
+    nChunksUsed = 0;
+    nextSlot = slotsPerChunk;
+    freeSlots = 0;
+    nLive = 0;
+  }
+  // Frees the chunks that no live (or free) slot is in.
+  void Trim() {
+    while (nChunksUsed < chunks.size()) {
+      ::operator delete(chunks.back());
+      chunks.pop_back();
+    }
+  }
+
+private:
+  size_t slotSize;
+  size_t slotsPerChunk;
+  vector<char *> chunks;
+  size_t nChunksUsed;
+  size_t nextSlot;
+  void *freeSlots;
+  size_t nLive;
+};
+
 class INode;
 class ONode;
 class PNode;
@@ -119,23 +431,69 @@ vector<INode *> INodes;
 vector<ONode *> ONodes;
 vector<PNode *> PNodes;
 
-class INode : public vector<ONode *> {
+// When set, each sample only pushes the INodes whose values actually
+// changed, and re-evaluates just their downstream cone, instead of
+// resetting and re-evaluating the whole network.
+
+bool incrementalEvaluation = true;
+
+// Every network starts out with this many INodes and ONodes.
+
+size_t nNetworkInputs = 3;
+size_t nNetworkOutputs = 1;
+
+// Unless evolving, each run develops and scores nGenomesPerRun random
+// genomes, against nSamplesPerGenome samples each.  A negative seed
+// seeds the run from the clock.
+
+size_t nGenomesPerRun = 10;
+size_t nSamplesPerGenome = 1000;
+long fixedSeed = -1;
+
+// Networks with at least this many PNodes are evaluated level by level,
+// without recursion, spread across nEvaluationThreads threads.
+
+size_t levelEvaluationThreshold = 10000;
+size_t nEvaluationThreads = max(1u, thread::hardware_concurrency());
+
+// When set, each pruned network is turned into a straight-line C++
+// function, built with compileCommand, and dlopen()ed for scoring.
+// That runs the compiler once for every network scored, evolving
+// included, which takes far longer than scoring all but the largest
+// networks does.  Each network's built in a private directory of its
+// own, made by mkdtemp() from compiledNetworkStem, and removed once
+// it's loaded.
+
+bool compiledEvaluation = false;
+string compileCommand = "c++ -std=c++11 -O2 -ffp-contract=off -fPIC -shared";
+string compiledNetworkStem = "/tmp/gp-network";
+
+// When set, an evolution run exports its best network, as
+// exportNetworkStem.cc and the exportNetworkStem.so built from it, and
+// with paretoSelection each network on the Pareto front, as
+// exportNetworkStem-<n>.  A run with loadNetworkPath set scores that
+// exported object against the samples that evolving with the same seed
+// would use, instead of developing anything.
+
+string exportNetworkStem;
+string loadNetworkPath;
+
+// INodes, ONodes and PNodes aren't polymorphic: a PNode is both an
+// INode and an ONode, and each of those knows whether it's part of one
+// (isProgram), and forwards to it where the PNode behaves differently.
+
+class INode : public EdgeList<ONode *, 4> {
 public:
   INode(std::initializer_list<ONode *> oNodes, int _oLink = 0);
   INode(vector<ONode *> const &oNodes, int _oLink = 0);
-  INode() : oLink(0) { }
-  virtual ~INode();
-  virtual string Name() const {
-    ostringstream s;
-    auto i = find(INodes.cbegin(), INodes.cend(), this);
-    if (i != INodes.cend()) {
-      s << "INodes[" << i - INodes.begin() << "]";
-    } else {
-      s << "INode";
-    }
-    return s.str();
-  }
-  virtual string toString() const;
+  INode() : oLink(0), evaluated(false), isProgram(false), value(0) { }
+  ~INode();
+  static void *operator new(size_t size);
+  static void operator delete(void *p);
+  PNode *asPNode();
+  PNode const *asPNode() const;
+  string Name() const;
+  string toString() const;
   void addOutputTo(ONode *oNode) {
     push_back(oNode);
   }
@@ -163,17 +521,24 @@ public:
     evaluated = true;
     value = _value;
   }
-  void Reset() { evaluated = false; }
-  virtual bool isEvaluated() const { return evaluated; }
-  virtual double Evaluate() {
-    evaluated = true;
-    // cout << Name() << "->Evaluate() = " << value << "\n";
-    return value;
+  void updateValue(double _value) {
+    if (evaluated && value == _value) {
+      return;
+    }
+    setValue(_value);
+    invalidateOutputs();
   }
+  void invalidateOutputs();
+  void Reset() { evaluated = false; }
+  bool isEvaluated() const;
+  double Evaluate();
 
 protected:
+  friend class PNode;
+
   int oLink;
   bool evaluated;
+  bool isProgram;
   double value;
 };
 
@@ -198,29 +563,24 @@ struct Input {
   double weight;
 };
 
-class ONode : public vector<Input> {
+class ONode : public EdgeList<Input, 4> {
 public:
   ONode(std::initializer_list<INode *> iNodes, int _iLink = 0);
   ONode(vector<INode *> const &iNodes, int _iLink = 0);
   ONode(std::initializer_list<Input> iNodes, int _iLink = 0);
-  ONode() : iLink(0), evaluated(false), value(0) { }
-  virtual ~ONode() {
+  ONode() : iLink(0), evaluated(false), isProgram(false), value(0) { }
+  ~ONode() {
     while (!empty()) {
       back().iNode->removeOutputTo(this);
       pop_back();
     }
   }
-  virtual string Name() const {
-    ostringstream s;
-    auto i = find(ONodes.cbegin(), ONodes.cend(), this);
-    if (i != ONodes.cend()) {
-      s << "ONodes[" << i - ONodes.begin() << "]";
-    } else {
-      s << "ONode";
-    }
-    return s.str();
-  }
-  virtual string toString() const;
+  static void *operator new(size_t size);
+  static void operator delete(void *p);
+  PNode *asPNode();
+  PNode const *asPNode() const;
+  string Name() const;
+  string toString() const;
   void addInputFrom(INode *iNode) {
     push_back(iNode);
   }
@@ -290,6 +650,7 @@ public:
     }
   }
   bool isEvaluated() const { return evaluated; }
+  void Invalidate() { evaluated = false; }
   double Evaluate() {
     if (!isEvaluated()) {
       // cout << Name() << "->Evaluate()...\n";
@@ -305,8 +666,11 @@ public:
   }
 
 protected:
+  friend class PNode;
+
   int iLink;
   bool evaluated;
+  bool isProgram;
   double value;
 };
 
@@ -325,6 +689,7 @@ public:
     genome(_genome),
     genomeReader(_genomeReader)
   {
+    INode::isProgram = ONode::isProgram = true;
   }
   PNode(vector<ONode *> const &oNodes,
 	vector<INode *> const &iNodes,
@@ -339,6 +704,7 @@ public:
     genome(_genome),
     genomeReader(_genomeReader)
   {
+    INode::isProgram = ONode::isProgram = true;
   }
   PNode(std::initializer_list<ONode *> oNodes,
 	std::initializer_list<Input> iNodes,
@@ -353,10 +719,13 @@ public:
     genome(_genome),
     genomeReader(_genomeReader)
   {
+    INode::isProgram = ONode::isProgram = true;
   }
-  virtual ~PNode() {
+  ~PNode() {
   }
-  virtual string Name() const {
+  static void *operator new(size_t size);
+  static void operator delete(void *p);
+  string Name() const {
     ostringstream s;
     auto i = find(PNodes.cbegin(), PNodes.cend(), this);
     if (i != PNodes.cend()) {
@@ -370,7 +739,7 @@ public:
     ostringstream s;
     s << Name() << ": {";
     if (isEvaluated()) {
-      s << " value = " << value;
+      s << " value = " << INode::value;
     } else {
       s << " value = ???";
     }
@@ -417,6 +786,12 @@ public:
     oNode->addInputFrom(this);
   }
   GKind getKind() const { return genomeReader->getKind(); }
+  double getThreshold() const { return threshold; }
+  int getILink() const { return iLink; }
+  int getOLink() const { return oLink; }
+  void setThreshold(double _threshold) { threshold = _threshold; }
+  GNode *getGenomeReader() const { return genomeReader; }
+  void setGenomeReader(GNode *_genomeReader) { genomeReader = _genomeReader; }
   bool Grow() {
     GKind kind = genomeReader->getKind();
 
@@ -571,33 +946,238 @@ public:
     return genomeReader->hasMore();
   }
   void Reset() { ONode::Reset(); }
-  virtual bool isEvaluated() const { return ONode::isEvaluated(); }
-  virtual double Evaluate() {
+  bool isEvaluated() const { return ONode::isEvaluated(); }
+  double Evaluate() {
     if (!isEvaluated()) {
       double oValue = ONode::Evaluate();
 
+      // Our INode side's value is what we pass on; our ONode side's is
+      // the sum of our inputs, before thresholding.
+
       if (threshold < 0.0) {
-        value = (oValue < threshold) ? oValue - threshold : threshold;
+        INode::value = (oValue < threshold) ? oValue - threshold : threshold;
       } else {
-        value = (threshold < oValue) ? oValue - threshold : threshold;
+        INode::value = (threshold < oValue) ? oValue - threshold : threshold;
       }
-      // cout << Name() << "->Evaluate() = " << value << " - " << threshold << "\n";
-      // value = oValue - threshold;
+      // cout << Name() << "->Evaluate() = " << INode::value << " - " << threshold << "\n";
+      // INode::value = oValue - threshold;
     }
-    return value;
+    return INode::value;
   }
 
 private:
-  PNode() : threshold(0), genome(0), genomeReader(0) { }
+  PNode() : threshold(0), genome(0), genomeReader(0) {
+    INode::isProgram = ONode::isProgram = true;
+  }
 
   double threshold;
-  double value;
   GNode *genome;
   GNode *genomeReader;
 };
 
+// Holds the storage for the (one) network in INodes, ONodes and
+// PNodes, which each worker process develops genome after genome.
+// Rather than deleting the previous genome's network node by node,
+// Reset() drops it wholesale, in constant time, and the next network is
+// built in the same chunks, so once they've grown to fit, developing a
+// network doesn't touch the heap at all.
+
+class NetworkPool {
+public:
+  NetworkPool() :
+    iNodePool(sizeof(INode)),
+    oNodePool(sizeof(ONode)),
+    pNodePool(sizeof(PNode))
+  {
+  }
+  void Reset() {
+    INodes.clear();
+    ONodes.clear();
+    PNodes.clear();
+    iNodePool.Reset();
+    oNodePool.Reset();
+    pNodePool.Reset();
+    edgeArena.Reset();
+  }
+  void Trim() {
+    iNodePool.Trim();
+    oNodePool.Trim();
+    pNodePool.Trim();
+    edgeArena.Trim();
+  }
+
+  NodePool iNodePool;
+  NodePool oNodePool;
+  NodePool pNodePool;
+  EdgeArena edgeArena;
+};
+
+NetworkPool networkPool;
+
+void *allocateEdges(size_t size) {
+  return networkPool.edgeArena.allocate(size);
+}
+
+// The network's edges, each of which is an Input in its ONode's list,
+// and an ONode * in its INode's.
+
+size_t countEdges() {
+  size_t nEdges = 0;
+  for (auto &o : ONodes) {
+    nEdges += o->size();
+  }
+  for (auto &p : PNodes) {
+    nEdges += p->ONode::size();
+  }
+  return nEdges;
+}
+
+// What the live genomes and the network hold, by category.  Edges are
+// held in their nodes, until a list outgrows its inline slots and
+// spills into the edge arena, so edgeBytes overlaps nodeBytes and
+// spilledEdgeBytes.  The network pool keeps its chunks when a network's
+// dropped, to build the next one in, so reservedBytes can be well over
+// what the nodes and edges use.
+
+struct MemoryUsage {
+  size_t nGNodes;
+  size_t gNodeBytes;
+  size_t nINodes;
+  size_t nONodes;
+  size_t nPNodes;
+  size_t nodeBytes;
+  size_t nEdges;
+  size_t edgeBytes;
+  size_t spilledEdgeBytes;
+  size_t reservedBytes;
+
+  size_t totalBytes() const { return gNodeBytes + reservedBytes; }
+  string toString() const {
+    ostringstream s;
+    s << nGNodes << " GNodes (" << gNodeBytes << " bytes)"
+      << ", " << nINodes << " INodes, " << nONodes << " ONodes, " << nPNodes << " PNodes (" << nodeBytes << " bytes)"
+      << ", " << nEdges << " edges (" << edgeBytes << " bytes, " << spilledEdgeBytes << " bytes of lists spilled)"
+      << ", " << reservedBytes << " bytes reserved for networks"
+      << ", " << totalBytes() << " bytes in all";
+    return s.str();
+  }
+};
+
+MemoryUsage measureMemory() {
+  MemoryUsage usage;
+  usage.nGNodes = GNode::getNLive();
+  usage.gNodeBytes = usage.nGNodes * sizeof(GNode);
+  usage.nINodes = networkPool.iNodePool.getNLive();
+  usage.nONodes = networkPool.oNodePool.getNLive();
+  usage.nPNodes = networkPool.pNodePool.getNLive();
+  usage.nodeBytes =
+    usage.nINodes * networkPool.iNodePool.getSlotSize() +
+    usage.nONodes * networkPool.oNodePool.getSlotSize() +
+    usage.nPNodes * networkPool.pNodePool.getSlotSize();
+  usage.nEdges = countEdges();
+  usage.edgeBytes = usage.nEdges * (sizeof(Input) + sizeof(ONode *));
+  usage.spilledEdgeBytes = networkPool.edgeArena.getBytesUsed();
+  usage.reservedBytes =
+    networkPool.iNodePool.getBytesReserved() +
+    networkPool.oNodePool.getBytesReserved() +
+    networkPool.pNodePool.getBytesReserved() +
+    networkPool.edgeArena.getBytesReserved();
+  return usage;
+}
+
+void *INode::operator new(size_t size) {
+  assert(size == sizeof(INode));
+  return networkPool.iNodePool.allocate();
+}
+
+void INode::operator delete(void *p) {
+  networkPool.iNodePool.release(p);
+}
+
+void *ONode::operator new(size_t size) {
+  assert(size == sizeof(ONode));
+  return networkPool.oNodePool.allocate();
+}
+
+void ONode::operator delete(void *p) {
+  networkPool.oNodePool.release(p);
+}
+
+void *PNode::operator new(size_t size) {
+  assert(size == sizeof(PNode));
+  return networkPool.pNodePool.allocate();
+}
+
+void PNode::operator delete(void *p) {
+  networkPool.pNodePool.release(p);
+}
+
+PNode *INode::asPNode() {
+  return isProgram ? static_cast<PNode *>(this) : 0;
+}
+
+PNode const *INode::asPNode() const {
+  return isProgram ? static_cast<PNode const *>(this) : 0;
+}
+
+PNode *ONode::asPNode() {
+  return isProgram ? static_cast<PNode *>(this) : 0;
+}
+
+PNode const *ONode::asPNode() const {
+  return isProgram ? static_cast<PNode const *>(this) : 0;
+}
+
+string INode::Name() const {
+  if (PNode const *pNode = asPNode()) {
+    return pNode->Name();
+  }
+
+  ostringstream s;
+  auto i = find(INodes.cbegin(), INodes.cend(), this);
+  if (i != INodes.cend()) {
+    s << "INodes[" << i - INodes.begin() << "]";
+  } else {
+    s << "INode";
+  }
+  return s.str();
+}
+
+bool INode::isEvaluated() const {
+  if (PNode const *pNode = asPNode()) {
+    return pNode->isEvaluated();
+  }
+  return evaluated;
+}
+
+double INode::Evaluate() {
+  if (PNode *pNode = asPNode()) {
+    return pNode->Evaluate();
+  }
+  if (!evaluated) {
+    evaluated = true;
+  }
+  // cout << Name() << "->Evaluate() = " << value << "\n";
+  return value;
+}
+
+string ONode::Name() const {
+  if (PNode const *pNode = asPNode()) {
+    return pNode->Name();
+  }
+
+  ostringstream s;
+  auto i = find(ONodes.cbegin(), ONodes.cend(), this);
+  if (i != ONodes.cend()) {
+    s << "ONodes[" << i - ONodes.begin() << "]";
+  } else {
+    s << "ONode";
+  }
+  return s.str();
+}
+
 INode::INode(std::initializer_list<ONode *> oNodes, int _oLink) :
-  oLink(_oLink)
+  oLink(_oLink), evaluated(false), isProgram(false), value(0)
 {
   for (auto o = oNodes.begin(); o != oNodes.end(); o++) {
     push_back(*o);
@@ -606,7 +1186,7 @@ INode::INode(std::initializer_list<ONode *> oNodes, int _oLink) :
 }
 
 INode::INode(vector<ONode *> const &oNodes, int _oLink) :
-  oLink(_oLink)
+  oLink(_oLink), evaluated(false), isProgram(false), value(0)
 {
   for (auto o = oNodes.begin(); o != oNodes.end(); o++) {
     push_back(*o);
@@ -623,6 +1203,10 @@ INode::~INode()
 }
 
 string INode::toString() const {
+  if (PNode const *pNode = asPNode()) {
+    return pNode->toString();
+  }
+
   ostringstream s;
   s << Name() << ": {";
   if (isEvaluated()) {
@@ -663,8 +1247,28 @@ void INode::cutONode() {
   pop_back();
 }
 
+void INode::invalidateOutputs() {
+  // Walk the forward links, clearing the cached values of everything
+  // downstream of us.  A node that's already unevaluated can't have an
+  // evaluated node downstream of it, so we can stop there.
+
+  static thread_local vector<ONode *> pending;
+  pending.assign(begin(), end());
+  while (!pending.empty()) {
+    ONode *oNode = pending.back();
+    pending.pop_back();
+
+    if (oNode->isEvaluated()) {
+      oNode->Invalidate();
+      if (PNode *pNode = oNode->asPNode()) {
+        pending.insert(pending.end(), pNode->INode::cbegin(), pNode->INode::cend());
+      }
+    }
+  }
+}
+
 ONode::ONode(std::initializer_list<INode *> iNodes, int _iLink) :
-  iLink(_iLink), evaluated(false), value(0)
+  iLink(_iLink), evaluated(false), isProgram(false), value(0)
 {
   for (auto i = iNodes.begin(); i != iNodes.end(); i++) {
     push_back({ *i, 1 });
@@ -673,7 +1277,7 @@ ONode::ONode(std::initializer_list<INode *> iNodes, int _iLink) :
 }
 
 ONode::ONode(vector<INode *> const &iNodes, int _iLink) :
-  iLink(_iLink), evaluated(false), value(0)
+  iLink(_iLink), evaluated(false), isProgram(false), value(0)
 {
   for (auto i = iNodes.begin(); i != iNodes.end(); i++) {
     push_back({ *i, 1 });
@@ -682,7 +1286,7 @@ ONode::ONode(vector<INode *> const &iNodes, int _iLink) :
 }
 
 ONode::ONode(std::initializer_list<Input> iNodes, int _iLink) :
-  iLink(_iLink), evaluated(false), value(0)
+  iLink(_iLink), evaluated(false), isProgram(false), value(0)
 {
   for (auto i = iNodes.begin(); i != iNodes.end(); i++) {
     push_back(*i);
@@ -691,6 +1295,10 @@ ONode::ONode(std::initializer_list<Input> iNodes, int _iLink) :
 }
 
 string ONode::toString() const {
+  if (PNode const *pNode = asPNode()) {
+    return pNode->toString();
+  }
+
   ostringstream s;
   s << Name() << ": {";
   if (isEvaluated()) {
@@ -735,58 +1343,639 @@ void Dump() {
   cout << "}\n";
 }
 
-GNode *buildRandom(size_t depth = 0) {
-  static size_t builtNRandomNodes;
-  static int likelihoods[EoKind] = {
-     50, // 5, // Ser
-     50, // 5, // Par
-     10, // 2, // IInc
-     10, // 2, // IDec
-      5, // 2, // ICut
-     10, // 2, // OInc
-     10, // 2, // ODec
-      5, // 2, // OCut
-     20, // 2, // WInc
-     20, // 2, // WDec
-     20, // 2, // WShl
-     20, // 2, // WShr
-     20, // 2, // TInc
-     20, // 2, // TDec
-     20, // 2, // TShl
-     20, // 2, // TShr
-     20, // 2, // Wait
-     10, // 1, // End
-  };
-  static int maxLikelihoods = 0;
+// A fixed set of threads that all run the same job, each given its own
+// index (the calling thread is index 0), and that Run() waits on.
 
-  if (!maxLikelihoods) {
-    for (auto k = Ser; k < EoKind; k = GKind(int(k) + 1)) {
-      maxLikelihoods += likelihoods[k];
+class WorkerPool {
+public:
+  WorkerPool(size_t nThreads) : job(0), generation(0), pending(0), stopping(false) {
+    for (size_t t = 1; t < nThreads; t += 1) {
+      workers.push_back(thread(&WorkerPool::work, this, t));
+    }
+  }
+  ~WorkerPool() {
+    {
+      unique_lock<mutex> lock(guard);
+      stopping = true;
+      generation += 1;
+    }
+    wake.notify_all();
+    for (auto &w : workers) {
+      w.join();
     }
   }
+  size_t size() const { return workers.size() + 1; }
+  void Run(function<void(size_t)> const &_job) {
+    if (workers.empty()) {
+      _job(0);
+      return;
+    }
+    {
+      unique_lock<mutex> lock(guard);
+      job = &_job;
+      pending = workers.size();
+      generation += 1;
+    }
+    wake.notify_all();
+    _job(0);
 
-  if (depth == 0) {
-    builtNRandomNodes = 0;
+    unique_lock<mutex> lock(guard);
+    done.wait(lock, [this] { return pending == 0; });
+    job = 0;
   }
 
-  builtNRandomNodes += 1;
-  if (2000 < builtNRandomNodes && rand() % 10 == 0) {
-    return new GNode(End);
+private:
+  void work(size_t t) {
+    size_t seen = 0;
+    for (;;) {
+      function<void(size_t)> const *current;
+      {
+	unique_lock<mutex> lock(guard);
+	wake.wait(lock, [this, seen] { return generation != seen; });
+	seen = generation;
+	if (stopping) {
+	  return;
+	}
+	current = job;
+      }
+      (*current)(t);
+      {
+	unique_lock<mutex> lock(guard);
+	if (--pending == 0) {
+	  done.notify_one();
+	}
+      }
+    }
   }
-  if (20 < depth && rand() % 4 == 0) {
-    return new GNode(End);
+
+  vector<thread> workers;
+  mutex guard;
+  condition_variable wake;
+  condition_variable done;
+  function<void(size_t)> const *job;
+  size_t generation;
+  size_t pending;
+  bool stopping;
+};
+
+// Levels are short, so the threads spin (politely) rather than sleep
+// between them.
+
+class SpinBarrier {
+public:
+  SpinBarrier(size_t _nThreads) : nThreads(_nThreads), nWaiting(0), phase(0) { }
+  void Wait() {
+    size_t p = phase.load(std::memory_order_acquire);
+    if (nWaiting.fetch_add(1, std::memory_order_acq_rel) + 1 == nThreads) {
+      nWaiting.store(0, std::memory_order_relaxed);
+      phase.fetch_add(1, std::memory_order_release);
+    } else {
+      while (phase.load(std::memory_order_acquire) == p) {
+	std::this_thread::yield();
+      }
+    }
   }
 
-  int choose = rand() % maxLikelihoods;
-  for (auto k = Ser; k < EoKind; k = GKind(int(k) + 1)) {
-    choose -= likelihoods[k];
-    if (choose <= 0) {
-      switch (k) {
-        case Ser:
-        case Par:
-          {
-            GNode *lChild = buildRandom(depth + 1);
-            GNode *rChild = buildRandom(depth + 1);
+private:
+  size_t nThreads;
+  atomic<size_t> nWaiting;
+  atomic<size_t> phase;
+};
+
+// Evaluates the current network (INodes, ONodes and PNodes) for one
+// sample: inputs[i] is given to INodes[i], and outputs[o] receives
+// ONodes[o]'s value.
+
+class Evaluator {
+public:
+  virtual ~Evaluator() { }
+  virtual string Name() const = 0;
+  virtual void Evaluate(vector<double> const &inputs, vector<double> &outputs) = 0;
+};
+
+// Resets every node and recursively evaluates the network from its
+// ONodes.
+
+class RecursiveEvaluator : public Evaluator {
+public:
+  string Name() const { return "recursive"; }
+  void Evaluate(vector<double> const &inputs, vector<double> &outputs) {
+    for (auto &i : INodes) {
+      i->Reset();
+    }
+    for (auto &o : ONodes) {
+      o->Reset();
+    }
+    for (auto &p : PNodes) {
+      p->Reset();
+    }
+
+    for (size_t i = 0; i < INodes.size(); i += 1) {
+      INodes[i]->setValue(inputs[i]);
+    }
+
+    for (auto &o : ONodes) {
+      o->Reset();
+    }
+
+    outputs.resize(ONodes.size());
+    for (size_t o = 0; o < ONodes.size(); o += 1) {
+      outputs[o] = ONodes[o]->Evaluate();
+    }
+  }
+};
+
+// Relies on the network still holding the values from the previous
+// sample (or from the pruning pass), and recomputes only the cones of
+// the INodes whose values changed.
+
+class IncrementalEvaluator : public Evaluator {
+public:
+  string Name() const { return "incremental"; }
+  void Evaluate(vector<double> const &inputs, vector<double> &outputs) {
+    for (size_t i = 0; i < INodes.size(); i += 1) {
+      INodes[i]->updateValue(inputs[i]);
+    }
+
+    outputs.resize(ONodes.size());
+    for (size_t o = 0; o < ONodes.size(); o += 1) {
+      outputs[o] = ONodes[o]->Evaluate();
+    }
+  }
+};
+
+// Sorts the nodes that the ONodes depend upon into levels, where each
+// node's inputs all lie in earlier levels.  pNode is set when the step's
+// oNode is a PNode.
+
+struct LevelStep {
+  ONode *oNode;
+  PNode *pNode;
+};
+
+vector<vector<LevelStep>> scheduleLevels() {
+  // An explicit depth-first walk back from the ONodes: a node is
+  // leveled once all of its PNode inputs have been.  Anything that isn't
+  // a PNode is an INode, and sits at level 0.
+
+  vector<vector<LevelStep>> levels;
+  unordered_map<PNode *, size_t> levelOf;
+  vector<std::pair<ONode *, size_t>> stack;
+
+  for (auto &o : ONodes) {
+    stack.push_back({ o, 0 });
+    while (!stack.empty()) {
+      ONode *oNode = stack.back().first;
+      size_t &next = stack.back().second;
+
+      if (next < oNode->size()) {
+	INode *iNode = (*oNode)[next].iNode;
+	next += 1;
+	PNode *pNode = iNode->asPNode();
+	if (pNode && !levelOf.count(pNode)) {
+	  levelOf[pNode] = 0; // In progress; the network is acyclic.
+	  stack.push_back({ pNode, 0 });
+	}
+	continue;
+      }
+
+      size_t level = 0;
+      for (auto i = oNode->cbegin(); i != oNode->cend(); i++) {
+	if (PNode *pNode = i->iNode->asPNode()) {
+	  level = max(level, levelOf[pNode]);
+	}
+      }
+
+      PNode *pNode = oNode->asPNode();
+      if (pNode) {
+	levelOf[pNode] = level + 1;
+      }
+      if (levels.size() <= level) {
+	levels.resize(level + 1);
+      }
+      levels[level].push_back({ oNode, pNode });
+      stack.pop_back();
+    }
+  }
+
+  return levels;
+}
+
+// Evaluates the scheduled levels in order, splitting each across the
+// pool's threads.  As every node's inputs are already evaluated by the
+// time it is, Evaluate() never recurses more than one call deep.
+
+class LevelEvaluator : public Evaluator {
+public:
+  LevelEvaluator(WorkerPool &_pool, size_t _minParallelLevel = 64) :
+    pool(_pool),
+    minParallelLevel(_minParallelLevel)
+  {
+    Schedule();
+  }
+  string Name() const { return "level"; }
+  void Schedule();
+  size_t nLevels() const { return levels.size(); }
+  void Evaluate();
+  void Evaluate(vector<double> const &inputs, vector<double> &outputs) {
+    for (size_t i = 0; i < INodes.size(); i += 1) {
+      INodes[i]->setValue(inputs[i]);
+    }
+
+    Evaluate();
+
+    outputs.resize(ONodes.size());
+    for (size_t o = 0; o < ONodes.size(); o += 1) {
+      outputs[o] = ONodes[o]->Evaluate();
+    }
+  }
+
+private:
+  WorkerPool &pool;
+  size_t minParallelLevel;
+  vector<vector<LevelStep>> levels;
+
+  // Runs of consecutive levels, [begin, end).  A wide level is a stretch
+  // of its own and is split across the threads; a run of narrow levels
+  // is one stretch that thread 0 walks alone, so a long chain costs one
+  // barrier rather than one per level.
+
+  struct Stretch {
+    size_t begin;
+    size_t end;
+    bool parallel;
+  };
+  vector<Stretch> stretches;
+  bool anyParallel;
+
+  void evaluateSerially(size_t begin, size_t end);
+};
+
+void LevelEvaluator::Schedule() {
+  levels = scheduleLevels();
+
+  stretches.clear();
+  anyParallel = false;
+  for (size_t l = 0; l < levels.size(); l += 1) {
+    bool parallel = minParallelLevel <= levels[l].size();
+    if (parallel || stretches.empty() || stretches.back().parallel) {
+      stretches.push_back({ l, l + 1, parallel });
+    } else {
+      stretches.back().end = l + 1;
+    }
+    anyParallel = anyParallel || parallel;
+  }
+}
+
+void LevelEvaluator::evaluateSerially(size_t begin, size_t end) {
+  for (size_t l = begin; l < end; l += 1) {
+    for (auto &step : levels[l]) {
+      if (step.pNode) {
+	step.pNode->Evaluate();
+      } else {
+	step.oNode->Evaluate();
+      }
+    }
+  }
+}
+
+void LevelEvaluator::Evaluate() {
+  // With no level wide enough to split, waking the pool only buys
+  // barriers.
+
+  if (!anyParallel) {
+    for (auto &level : levels) {
+      for (auto &step : level) {
+	step.oNode->Invalidate();
+      }
+    }
+    evaluateSerially(0, levels.size());
+    return;
+  }
+
+  SpinBarrier barrier(pool.size());
+
+  pool.Run([this, &barrier](size_t t) {
+      size_t nThreads = pool.size();
+
+      for (auto &level : levels) {
+	size_t n = level.size();
+	size_t lo = n * t / nThreads;
+	size_t hi = n * (t + 1) / nThreads;
+	for (size_t s = lo; s < hi; s += 1) {
+	  level[s].oNode->Invalidate();
+	}
+      }
+      barrier.Wait();
+
+      for (auto &stretch : stretches) {
+	if (!stretch.parallel) {
+	  if (t == 0) {
+	    evaluateSerially(stretch.begin, stretch.end);
+	  }
+	  barrier.Wait();
+	  continue;
+	}
+
+	auto &level = levels[stretch.begin];
+	size_t n = level.size();
+	size_t lo = n * t / nThreads;
+	size_t hi = n * (t + 1) / nThreads;
+	for (size_t s = lo; s < hi; s += 1) {
+	  LevelStep &step = level[s];
+	  if (step.pNode) {
+	    step.pNode->Evaluate();
+	  } else {
+	    step.oNode->Evaluate();
+	  }
+	}
+	barrier.Wait();
+      }
+    });
+}
+
+// Writes the current network out as a C++ function,
+//
+//   extern "C" void gp_evaluate(double const *inputs, double *outputs)
+//
+// with its topology, weights and thresholds baked in, summing each
+// node's inputs in the same order that ONode::Evaluate() does so the
+// results match it exactly.
+
+string toLiteral(double d) {
+  if (std::isnan(d)) {
+    return "NAN";
+  }
+  if (std::isinf(d)) {
+    return d < 0 ? "-HUGE_VAL" : "HUGE_VAL";
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.17g", d);
+  string literal(buffer);
+  if (literal.find_first_of(".en") == string::npos) {
+    literal += ".0";
+  }
+  return "(" + literal + ")";
+}
+
+bool writeNetworkSource(string const &path) {
+  ofstream out(path.c_str());
+  if (!out) {
+    return false;
+  }
+
+  unordered_map<INode *, string> nameOf;
+  for (size_t i = 0; i < INodes.size(); i += 1) {
+    ostringstream s;
+    s << "inputs[" << i << "]";
+    nameOf[INodes[i]] = s.str();
+  }
+
+  auto sumInputs = [&out, &nameOf](ONode *oNode) {
+    out << "  s = 0;\n";
+    for (auto i = oNode->cbegin(); i != oNode->cend(); i++) {
+      out << "  s += " << nameOf[i->iNode] << " * " << toLiteral(i->weight) << ";\n";
+    }
+    out << "  s = tanh(s);\n";
+  };
+
+  out << "// Generated by gp from a developed network.\n";
+  out << "#include <cmath>\n";
+  out << "extern \"C\" unsigned const gp_nInputs = " << INodes.size() << ";\n";
+  out << "extern \"C\" unsigned const gp_nOutputs = " << ONodes.size() << ";\n";
+  out << "extern \"C\" void gp_evaluate(double const *inputs, double *outputs) {\n";
+  out << "  double s;\n";
+
+  size_t nPNodes = 0;
+  auto levels = scheduleLevels();
+  for (auto &level : levels) {
+    for (auto &step : level) {
+      if (!step.pNode) {
+	continue;
+      }
+
+      ostringstream name;
+      name << "p" << nPNodes++;
+      nameOf[step.pNode] = name.str();
+
+      double threshold = step.pNode->getThreshold();
+      sumInputs(step.pNode);
+      out << "  double const " << name.str() << " = ";
+      if (threshold < 0.0) {
+	out << "(s < " << toLiteral(threshold) << ")";
+      } else {
+	out << "(" << toLiteral(threshold) << " < s)";
+      }
+      out << " ? s - " << toLiteral(threshold) << " : " << toLiteral(threshold) << ";\n";
+    }
+  }
+
+  for (size_t o = 0; o < ONodes.size(); o += 1) {
+    sumInputs(ONodes[o]);
+    out << "  outputs[" << o << "] = s;\n";
+  }
+  out << "}\n";
+
+  return bool(out);
+}
+
+// Loads a network's gp_evaluate() from a shared object, either one
+// built by Compile() from the current network, or one that Build()
+// exported earlier.  isLoaded() is false if anything went wrong, and
+// the reason has been written to cerr.
+
+class CompiledEvaluator : public Evaluator {
+public:
+  CompiledEvaluator(string const &soPath) : handle(0), function(0), nInputs(0), nOutputs(0) {
+    Load(soPath);
+  }
+  ~CompiledEvaluator() {
+    if (handle) {
+      dlclose(handle);
+    }
+  }
+  static bool Build(string const &stem);
+  static CompiledEvaluator *Compile(string const &stem);
+  string Name() const { return "compiled"; }
+  bool isLoaded() const { return function != 0; }
+  size_t getNInputs() const { return nInputs; }
+  size_t getNOutputs() const { return nOutputs; }
+  void Evaluate(vector<double> const &inputs, vector<double> &outputs) {
+    outputs.resize(nOutputs);
+    function(inputs.data(), outputs.data());
+  }
+
+private:
+  typedef void (*EvaluateFunction)(double const *inputs, double *outputs);
+
+  void Load(string const &soPath) {
+    handle = dlopen(soPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+      cerr << "CompiledEvaluator: " << dlerror() << "\n";
+      return;
+    }
+    unsigned const *nI = (unsigned const *) dlsym(handle, "gp_nInputs");
+    unsigned const *nO = (unsigned const *) dlsym(handle, "gp_nOutputs");
+    if (!nI || !nO) {
+      cerr << "CompiledEvaluator: " << soPath << " doesn't say how many inputs and outputs it has\n";
+      return;
+    }
+    nInputs = *nI;
+    nOutputs = *nO;
+    function = EvaluateFunction(dlsym(handle, "gp_evaluate"));
+    if (!function) {
+      cerr << "CompiledEvaluator: " << dlerror() << "\n";
+    }
+  }
+
+  void *handle;
+  EvaluateFunction function;
+  size_t nInputs;
+  size_t nOutputs;
+};
+
+// Runs compileCommand, split at whitespace, with "-o soPath ccPath"
+// added.  It's run directly rather than through the shell, so the paths
+// can hold anything.
+
+bool runCompiler(string const &soPath, string const &ccPath) {
+  vector<string> words;
+  std::istringstream in(compileCommand);
+  for (string word; in >> word; /* empty */) {
+    words.push_back(word);
+  }
+  if (words.empty()) {
+    cerr << "CompiledEvaluator: compileCommand is empty\n";
+    return false;
+  }
+  words.push_back("-o");
+  words.push_back(soPath);
+  words.push_back(ccPath);
+
+  vector<char *> argv;
+  for (auto &word : words) {
+    argv.push_back(&word[0]);
+  }
+  argv.push_back(0);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  int status;
+  if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    cerr << "CompiledEvaluator: " << compileCommand << " -o " << soPath << " " << ccPath << " failed\n";
+    return false;
+  }
+  return true;
+}
+
+// Writes the current network out as stem.cc, and builds stem.so from
+// it.
+
+bool CompiledEvaluator::Build(string const &stem) {
+  string ccPath = stem + ".cc";
+  string soPath = stem + ".so";
+
+  if (!writeNetworkSource(ccPath)) {
+    cerr << "CompiledEvaluator: can't write " << ccPath << "\n";
+    return false;
+  }
+  return runCompiler(soPath, ccPath);
+}
+
+CompiledEvaluator *CompiledEvaluator::Compile(string const &stem) {
+  // Nobody else can write to a directory mkdtemp() makes, and as every
+  // network gets one of its own, dlopen() never mistakes one for one it
+  // has already loaded.
+
+  string dirTemplate = stem + "-XXXXXX";
+  vector<char> dir(dirTemplate.begin(), dirTemplate.end());
+  dir.push_back('\0');
+  if (!mkdtemp(dir.data())) {
+    cerr << "CompiledEvaluator: can't make a directory from " << dirTemplate << ": " << strerror(errno) << "\n";
+    return 0;
+  }
+  string network = string(dir.data()) + "/network";
+  string ccPath = network + ".cc";
+  string soPath = network + ".so";
+
+  bool built = Build(network);
+  CompiledEvaluator *evaluator = built ? new CompiledEvaluator(soPath) : 0;
+  remove(ccPath.c_str());
+  remove(soPath.c_str());
+  rmdir(dir.data());
+  if (!evaluator) {
+    return 0;
+  }
+  if (!evaluator->isLoaded()) {
+    delete evaluator;
+    return 0;
+  }
+  return evaluator;
+}
+
+// buildRandom() picks the kind of each genome node with these relative
+// likelihoods.  It ends a branch early, with odds of 1 in
+// randomGenomeNodeOdds, once the genome (or subtree, when it starts
+// deeper than 0) has more than randomGenomeNodes nodes, and with odds
+// of 1 in randomGenomeDepthOdds, once the branch is deeper than
+// randomGenomeDepth.
+
+int randomGenomeLikelihoods[EoKind] = {
+     50, // 5, // Ser
+     50, // 5, // Par
+     10, // 2, // IInc
+     10, // 2, // IDec
+      5, // 2, // ICut
+     10, // 2, // OInc
+     10, // 2, // ODec
+      5, // 2, // OCut
+     20, // 2, // WInc
+     20, // 2, // WDec
+     20, // 2, // WShl
+     20, // 2, // WShr
+     20, // 2, // TInc
+     20, // 2, // TDec
+     20, // 2, // TShl
+     20, // 2, // TShr
+     20, // 2, // Wait
+     10, // 1, // End
+};
+size_t randomGenomeNodes = 2000;
+int randomGenomeNodeOdds = 10;
+size_t randomGenomeDepth = 20;
+int randomGenomeDepthOdds = 4;
+
+// nBuilt counts the nodes built so far by this call's outermost
+// buildRandom().
+
+GNode *buildRandom(size_t depth, size_t &nBuilt) {
+  int const *likelihoods = randomGenomeLikelihoods;
+  int maxLikelihoods = 0;
+  for (auto k = Ser; k < EoKind; k = GKind(int(k) + 1)) {
+    maxLikelihoods += likelihoods[k];
+  }
+
+  nBuilt += 1;
+  if (randomGenomeNodes < nBuilt && rand() % randomGenomeNodeOdds == 0) {
+    return new GNode(End);
+  }
+  if (randomGenomeDepth < depth && rand() % randomGenomeDepthOdds == 0) {
+    return new GNode(End);
+  }
+
+  int choose = rand() % maxLikelihoods;
+  for (auto k = Ser; k < EoKind; k = GKind(int(k) + 1)) {
+    choose -= likelihoods[k];
+    if (choose <= 0) {
+      switch (k) {
+        case Ser:
+        case Par:
+          {
+            GNode *lChild = buildRandom(depth + 1, nBuilt);
+            GNode *rChild = buildRandom(depth + 1, nBuilt);
             return new GNode(k, lChild, rChild);
           }
         case IInc:
@@ -805,7 +1994,7 @@ GNode *buildRandom(size_t depth = 0) {
         case TShr:
         case Wait:
           {
-            GNode *lChild = buildRandom(depth + 1);
+            GNode *lChild = buildRandom(depth + 1, nBuilt);
             return new GNode(k, lChild);
           }
         case End:
@@ -815,161 +2004,2456 @@ GNode *buildRandom(size_t depth = 0) {
       }
     }
   }
-  return new GNode(End);
+  return new GNode(End);
+}
+
+GNode *buildRandom(size_t depth = 0) {
+  size_t nBuilt = 0;
+  return buildRandom(depth, nBuilt);
+}
+
+// Grows each of the PNodes that existed at the start of the cycle by
+// one step, in order.  Returns true once nothing more can grow.
+
+bool developCycle() {
+  size_t hasMore = 0;
+  size_t nPNodes = PNodes.size();
+
+  for (size_t p = 0; p < nPNodes; p += 1) {
+    PNode *pNode = PNodes[p];
+
+    if (pNode->hasMore()) {
+      // cout << "# Growing by "
+      //      << ::toString(pNode->getKind())
+      //      << ": "
+      //      << pNode->toString()
+      //      << "\n";
+
+      if (!pNode->Grow()) {
+	hasMore += 1;
+      }
+    }
+  }
+
+  return 0 == hasMore && nPNodes == PNodes.size();
+}
+
+// Develops the network in INodes, ONodes and PNodes until no PNode can
+// grow any further.
+
+void developNetwork() {
+  bool isDone = false;
+  for (size_t cycle = 0; !isDone; cycle += 1) {
+    isDone = developCycle();
+
+    // cout << "# "
+    // 	 << cycle
+    // 	 << " ------------------------------------------------------------------------\n";
+    // Dump();
+  }
+}
+
+// Develops a network from a genome compiled into a flat program of
+// steps, rather than by walking the genome with PNode::Grow().  Each
+// PNode's position in the program is kept alongside it, only the PNodes
+// still growing are visited, and each cycle dispatches straight from one
+// PNode's step to the next (with computed gotos, where the compiler has
+// them).
+//
+// Runs of the same kind of step are fused into one step with a count.
+// A run that only changes the PNode's own links or threshold is applied
+// all at once, and the PNode then sits out the rest of the run's
+// cycles; nobody else can see the difference.  A run of weight steps is
+// applied a step per cycle, as the edge it applies to can be moved by
+// other PNodes' steps in the meantime, but still without refetching.
+//
+// Only benchmarkDevelopment() and the differential test use it.  Every
+// genome node is taken by at most one PNode, so compiling the genome
+// costs about as much as walking it does, and a genome is developed
+// once; the VM only comes out ahead with compiling left out.
+
+class DevelopmentVM {
+public:
+  DevelopmentVM(GNode *genome) : root(genome) { Compile(genome); }
+  size_t programSize() const { return program.size(); }
+  size_t genomeSize() const {
+    size_t n = 0;
+    for (auto &step : program) {
+      n += step.count;
+    }
+    return n;
+  }
+  void Develop();
+
+private:
+  struct Step {
+    GKind kind;
+    uint32_t count;
+    uint32_t next;
+    uint32_t sibling;
+    GNode *gNode;
+  };
+  struct State {
+    uint32_t pc;
+    uint32_t k;
+  };
+
+  static bool isFusable(GKind kind) { return kind != Ser && kind != Par && kind != ICut && kind != OCut && kind != End; }
+
+  uint32_t Compile(GNode *gNode);
+  bool Cycle();
+
+  GNode *root;
+  vector<Step> program;
+  vector<State> states;
+  vector<uint32_t> active;
+  vector<uint32_t> stillActive;
+  vector<uint32_t> born;
+};
+
+uint32_t DevelopmentVM::Compile(GNode *gNode) {
+  uint32_t pc = program.size();
+  program.push_back({ gNode->getKind(), 1, pc, pc, gNode });
+
+  GNode *next = gNode->getNext();
+  if (isFusable(gNode->getKind())) {
+    while (next && next->getKind() == gNode->getKind()) {
+      program[pc].count += 1;
+      next = next->getNext();
+    }
+  }
+
+  if (next) {
+    uint32_t nextPc = Compile(next);
+    program[pc].next = nextPc;
+  }
+  if ((gNode->getKind() == Ser || gNode->getKind() == Par) && gNode->getSibling()) {
+    uint32_t siblingPc = Compile(gNode->getSibling());
+    program[pc].sibling = siblingPc;
+  }
+  return pc;
+}
+
+void DevelopmentVM::Develop() {
+  // Any PNode that isn't just starting on the genome gets a program of
+  // its own, from wherever it's got to.
+
+  states.clear();
+  for (auto &p : PNodes) {
+    states.push_back({ p->getGenomeReader() == root ? 0 : Compile(p->getGenomeReader()), 0 });
+  }
+  active.clear();
+  for (size_t p = 0; p < PNodes.size(); p += 1) {
+    if (program[states[p].pc].kind != End) {
+      active.push_back(p);
+    }
+  }
+
+  while (!Cycle()) {
+  }
+
+  for (size_t p = 0; p < PNodes.size(); p += 1) {
+    PNodes[p]->setGenomeReader(program[states[p].pc].gNode);
+  }
+}
+
+bool DevelopmentVM::Cycle() {
+  size_t hasMore = 0;
+  size_t nPNodes = PNodes.size();
+  size_t a = 0;
+  size_t p;
+  PNode *pNode;
+  Step const *step;
+
+  stillActive.clear();
+  born.clear();
+  if (active.empty()) {
+    return true;
+  }
+
+#if defined(__GNUC__)
+  static void *const dispatch[EoKind] = {
+    &&doSer, &&doPar,
+    &&doIInc, &&doIDec, &&doICut,
+    &&doOInc, &&doODec, &&doOCut,
+    &&doWInc, &&doWDec, &&doWShl, &&doWShr,
+    &&doTInc, &&doTDec, &&doTShl, &&doTShr,
+    &&doWait, &&doEnd,
+  };
+#define DISPATCH() goto *dispatch[step->kind]
+#else
+#define DISPATCH()						\
+  switch (step->kind) {						\
+  case Ser: goto doSer;						\
+  case Par: goto doPar;						\
+  case IInc: goto doIInc;					\
+  case IDec: goto doIDec;					\
+  case ICut: goto doICut;					\
+  case OInc: goto doOInc;					\
+  case ODec: goto doODec;					\
+  case OCut: goto doOCut;					\
+  case WInc: goto doWInc;					\
+  case WDec: goto doWDec;					\
+  case WShl: goto doWShl;					\
+  case WShr: goto doWShr;					\
+  case TInc: goto doTInc;					\
+  case TDec: goto doTDec;					\
+  case TShl: goto doTShl;					\
+  case TShr: goto doTShr;					\
+  case Wait: goto doWait;					\
+  default: goto doEnd;						\
+  }
+#endif
+
+  // Fetch the next PNode's step and go straight to it.
+#define NEXT()							\
+  do {								\
+    if (++a == active.size()) {					\
+      goto cycleDone;						\
+    }								\
+    p = active[a];						\
+    pNode = PNodes[p];						\
+    step = &program[states[p].pc];				\
+    DISPATCH();							\
+  } while (0)
+
+  // Count off one cycle of the current step, moving on after its last.
+#define ADVANCE()						\
+  do {								\
+    State &state = states[p];					\
+    state.k += 1;						\
+    if (state.k == step->count) {				\
+      state.pc = step->next;					\
+      state.k = 0;						\
+    }								\
+    if (program[state.pc].kind != End) {			\
+      stillActive.push_back(p);					\
+      hasMore += 1;						\
+    }								\
+    NEXT();							\
+  } while (0)
+
+  // A sibling starts growing next cycle, after all of the older PNodes.
+#define BEAR()							\
+  do {								\
+    states.push_back({ step->sibling, 0 });			\
+    if (program[step->sibling].kind != End) {			\
+      born.push_back(PNodes.size() - 1);			\
+    }								\
+  } while (0)
+
+  // A run of steps private to the PNode all happens in its first cycle.
+#define ONCE_PER_RUN(body)					\
+  do {								\
+    if (states[p].k == 0) {					\
+      for (uint32_t n = 0; n < step->count; n += 1) {		\
+	body;							\
+      }								\
+    }								\
+    ADVANCE();							\
+  } while (0)
+
+  p = active[a];
+  pNode = PNodes[p];
+  step = &program[states[p].pc];
+  DISPATCH();
+
+ doSer:
+  pNode->setGenomeReader(step->gNode);
+  pNode->splitSerially();
+  BEAR();
+  ADVANCE();
+ doPar:
+  pNode->setGenomeReader(step->gNode);
+  pNode->splitParallel();
+  BEAR();
+  ADVANCE();
+ doIInc:
+  ONCE_PER_RUN(pNode->bumpILink(+1));
+ doIDec:
+  ONCE_PER_RUN(pNode->bumpILink(-1));
+ doICut:
+  pNode->cutINode();
+  ADVANCE();
+ doOInc:
+  ONCE_PER_RUN(pNode->bumpOLink(+1));
+ doODec:
+  ONCE_PER_RUN(pNode->bumpOLink(-1));
+ doOCut:
+  pNode->cutONode();
+  ADVANCE();
+ doWInc:
+  pNode->bumpInputWeight(+1);
+  ADVANCE();
+ doWDec:
+  pNode->bumpInputWeight(-1);
+  ADVANCE();
+ doWShl:
+  pNode->shiftInputWeight(+1);
+  ADVANCE();
+ doWShr:
+  pNode->shiftInputWeight(-1);
+  ADVANCE();
+ doTInc:
+  ONCE_PER_RUN(pNode->bumpThreshold(+1));
+ doTDec:
+  ONCE_PER_RUN(pNode->bumpThreshold(-1));
+ doTShl:
+  ONCE_PER_RUN(pNode->shiftThreshold(+1));
+ doTShr:
+  ONCE_PER_RUN(pNode->shiftThreshold(-1));
+ doWait:
+  ADVANCE();
+ doEnd:
+  NEXT();
+
+#undef ONCE_PER_RUN
+#undef BEAR
+#undef ADVANCE
+#undef NEXT
+#undef DISPATCH
+
+ cycleDone:
+  active.swap(stillActive);
+  active.insert(active.end(), born.begin(), born.end());
+  return 0 == hasMore && nPNodes == PNodes.size();
+}
+
+// Evaluates the network once, from its ONodes, and deletes every PNode
+// that they don't depend upon; then, unless keepTerminals is set (so
+// that INodes[i] and ONodes[o] stay where they were), every ONode
+// without inputs and every INode without outputs.
+
+void pruneNetwork(WorkerPool &pool, bool keepTerminals = false) {
+  if (levelEvaluationThreshold <= PNodes.size()) {
+    LevelEvaluator(pool).Evaluate();
+  } else {
+    for (auto &o : ONodes) {
+      o->Evaluate();
+    }
+  }
+
+  for (size_t p = 0; p < PNodes.size(); /* empty */) {
+    if (!PNodes[p]->isEvaluated()) {
+      if ((p + 1) < PNodes.size()) {
+	std::swap(PNodes[p], PNodes.back());
+      }
+      delete PNodes.back();
+      PNodes.pop_back();
+    } else {
+      p += 1;
+    }
+  }
+  if (keepTerminals) {
+    return;
+  }
+  for (size_t o = 0; o < ONodes.size(); /* empty */) {
+    if (ONodes[o]->empty()) {
+      if ((o + 1) < ONodes.size()) {
+	std::swap(ONodes[o], ONodes.back());
+      }
+      delete ONodes.back();
+      ONodes.pop_back();
+    } else {
+      o += 1;
+    }
+  }
+  for (size_t i = 0; i < INodes.size(); /* empty */) {
+    if (INodes[i]->empty()) {
+      if ((i + 1) < INodes.size()) {
+	std::swap(INodes[i], INodes.back());
+      }
+      delete INodes.back();
+      INodes.pop_back();
+    } else {
+      i += 1;
+    }
+  }
+}
+
+// The evaluator that the settings above call for, for the current
+// (pruned) network.
+
+Evaluator *newEvaluator(WorkerPool &pool) {
+  Evaluator *evaluator = 0;
+  if (compiledEvaluation) {
+    evaluator = CompiledEvaluator::Compile(compiledNetworkStem);
+  }
+  if (!evaluator) {
+    if (levelEvaluationThreshold <= PNodes.size()) {
+      evaluator = new LevelEvaluator(pool);
+    } else if (incrementalEvaluation) {
+      evaluator = new IncrementalEvaluator();
+    } else {
+      evaluator = new RecursiveEvaluator();
+    }
+  }
+  return evaluator;
+}
+
+// Builds the starting network for a genome: a single PNode, connected to
+// every INode and ONode.
+
+void seedNetwork(GNode *genome) {
+  networkPool.Reset();
+
+  for (size_t o = 0; o < nNetworkOutputs; o += 1) {
+    ONodes.push_back(new ONode());
+  }
+
+  for (size_t i = 0; i < nNetworkInputs; i += 1) {
+    INodes.push_back(new INode());
+  }
+
+  for (auto &i : INodes) {
+    i->setValue(0);
+  }
+
+  PNodes.push_back(new PNode(ONodes, INodes, 0, 0, genome, genome));
+}
+
+// Times developing nGenomes random genomes with PNode::Grow() against
+// DevelopmentVM, with compiling the genomes timed separately.
+
+void benchmarkDevelopment(size_t nGenomes) {
+  typedef std::chrono::steady_clock Clock;
+  Clock::duration growTime(0);
+  Clock::duration compileTime(0);
+  Clock::duration vmTime(0);
+  size_t nPNodes = 0;
+  size_t nGenomeNodes = 0;
+  size_t nProgramSteps = 0;
+
+  for (size_t g = 0; g < nGenomes; g += 1) {
+    Genome genome(buildRandom(0));
+
+    seedNetwork(genome.get());
+    Clock::time_point start = Clock::now();
+    while (!developCycle()) {
+    }
+    growTime += Clock::now() - start;
+    nPNodes += PNodes.size();
+    size_t growPNodes = PNodes.size();
+
+    seedNetwork(genome.get());
+    start = Clock::now();
+    DevelopmentVM vm(genome.get());
+    compileTime += Clock::now() - start;
+    start = Clock::now();
+    vm.Develop();
+    vmTime += Clock::now() - start;
+    nProgramSteps += vm.programSize();
+    nGenomeNodes += vm.genomeSize();
+
+    if (growPNodes != PNodes.size()) {
+      cerr << "benchmarkDevelopment: genome " << g << " developed into "
+	   << growPNodes << " PNodes by Grow(), but " << PNodes.size() << " by the VM\n";
+    }
+  }
+  networkPool.Reset();
+
+  auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+  cout << "Developed " << nGenomes << " genomes into " << nPNodes << " PNodes\n";
+  cout << "    PNode::Grow(): " << ms(growTime) << " ms\n";
+  cout << "    DevelopmentVM: " << ms(vmTime) << " ms, plus "
+       << ms(compileTime) << " ms compiling " << nGenomeNodes << " genome nodes into "
+       << nProgramSteps << " steps\n";
+  cout << "    speedup: " << ms(growTime) / ms(vmTime)
+       << " (" << ms(growTime) / ms(vmTime + compileTime) << " including compiling)\n";
+}
+
+// Settings for evolution, by evolveIsland() and runIslands().
+
+struct EvolutionSettings {
+  size_t nIslands = 1;
+  size_t populationSize = 50;
+  size_t nGenerations = 50;
+  size_t nElites = 2;
+  size_t tournamentSize = 3;
+  double crossoverRate = 0.7;
+  double mutationRate = 0.3;
+  size_t mutationDepth = 18;
+  size_t maxGenomeNodes = 20000;
+  size_t nSamples = 200;
+
+  // Before it's scored, each developed network may take this many
+  // gradient descent steps on its weights and thresholds (see
+  // GradientTuner), each of gradientRate times the mean gradient.
+  size_t gradientSteps = 0;
+  double gradientRate = 0.05;
+
+  // When set, selection is by Pareto rank over error and network cost
+  // (see Individual::dominates()), rather than by error alone, and the
+  // islands report their Pareto fronts.  The cost is the network's size
+  // unless paretoTiming is set, when how long it took to evaluate the
+  // samples counts too; as that varies from run to run, so does which
+  // individuals survive, even from the same seed.
+  bool paretoSelection = false;
+  bool paretoTiming = false;
+
+  // With surrogateScreening, a SurrogateModel predicts each offspring's
+  // error from its genome, and only those predicted to beat the
+  // surrogateQuantile of their parents' errors are developed and scored
+  // in full.  A surrogateExploration fraction of the rest are scored
+  // anyway, so that the model keeps learning where it's wrong, and none
+  // are screened out until it's been trained on surrogateWarmup genomes.
+  bool surrogateScreening = false;
+  double surrogateQuantile = 0.5;
+  double surrogateExploration = 0.1;
+  size_t surrogateWarmup = 50;
+  size_t surrogateCycles = 4;
+
+  // With memoryReport, each generation reports measureMemory().  Past
+  // memoryCeiling bytes (if set), an island first frees the network
+  // pool's spare chunks, then drops the worst of its population, and
+  // carries on with the smaller one.
+  bool memoryReport = false;
+  size_t memoryCeiling = 0;
+
+  // Every migrationInterval generations, each island sends copies of
+  // its migrationSize best genomes to its neighbours: the next island
+  // along for a "ring", every other island for "complete", or one
+  // other island picked at random for "random".
+  size_t migrationInterval = 5;
+  size_t migrationSize = 2;
+  string migrationTopology = "ring";
+  size_t migrationSlots = 4;
+  size_t migrationSlotBytes = 1 << 16;
+};
+
+EvolutionSettings evolution;
+
+// The task: every output should be the mean of the inputs.
+
+struct Sample {
+  vector<double> inputs;
+  double target;
+};
+
+vector<Sample> makeSamples(size_t nSamples) {
+  vector<Sample> samples(nSamples);
+  for (auto &sample : samples) {
+    sample.target = 0.0;
+    for (size_t i = 0; i < nNetworkInputs; i += 1) {
+      double value = rand() % 11 - 5;
+      sample.inputs.push_back(value);
+      sample.target += value;
+    }
+    sample.target /= nNetworkInputs;
+  }
+  return samples;
+}
+
+double sumSquaredError(Evaluator &evaluator, vector<Sample> const &samples) {
+  vector<double> outputs;
+  double sumSquaredError = 0.0;
+  for (auto &sample : samples) {
+    evaluator.Evaluate(sample.inputs, outputs);
+    for (auto &result : outputs) {
+      double error = sample.target - result;
+      sumSquaredError += error * error;
+    }
+  }
+  return std::isnan(sumSquaredError) ? HUGE_VAL : sumSquaredError;
+}
+
+// Fine-tunes the current network's weights and thresholds by gradient
+// descent on its sum squared error over the samples, propagating
+// derivatives back through tanh() and PNode::Evaluate()'s threshold
+// rule.  Where the rule passes o - t on, its derivatives by o and t are
+// 1 and -1; where it holds at t, they're 0 and 1.  Development can only
+// move weights and thresholds in whole steps or powers of two, so this
+// spares evolution many generations spent tuning constants.
+
+class GradientTuner {
+public:
+  GradientTuner(vector<Sample> const &_samples);
+
+  // Takes nSteps steps, and leaves the network with the weights and
+  // thresholds that gave the lowest error, which it returns.
+  double Tune(size_t nSteps, double rate);
+
+private:
+  static size_t const none = ~size_t(0);
+
+  void saveParameters(vector<double> &weights, vector<double> &thresholds) const;
+  void restoreParameters(vector<double> const &weights, vector<double> const &thresholds);
+  double accumulateGradient();
+
+  vector<Sample> const &samples;
+  vector<LevelStep> steps;         // Inputs before outputs.
+  vector<size_t> firstInput;       // steps[s]'s inputs, numbered across all steps.
+  vector<size_t> sourceOf;         // Which step each input comes from, if any.
+  vector<size_t> outputOf;         // Which ONode each step is, if any.
+  vector<double> adjoint;          // d error / d each step's (thresholded) value.
+  vector<double> weightGradient;
+  vector<double> thresholdGradient;
+};
+
+size_t const GradientTuner::none;
+
+GradientTuner::GradientTuner(vector<Sample> const &_samples) : samples(_samples) {
+  unordered_map<PNode *, size_t> stepOf;
+  for (auto &level : scheduleLevels()) {
+    for (auto &step : level) {
+      if (step.pNode) {
+	stepOf[step.pNode] = steps.size();
+      }
+      steps.push_back(step);
+    }
+  }
+
+  for (auto &step : steps) {
+    firstInput.push_back(sourceOf.size());
+    for (auto i = step.oNode->cbegin(); i != step.oNode->cend(); i++) {
+      PNode *pNode = i->iNode->asPNode();
+      sourceOf.push_back(pNode ? stepOf[pNode] : none);
+    }
+    size_t o = find(ONodes.begin(), ONodes.end(), step.oNode) - ONodes.begin();
+    outputOf.push_back(!step.pNode && o < ONodes.size() ? o : none);
+  }
+  firstInput.push_back(sourceOf.size());
+
+  adjoint.resize(steps.size());
+  weightGradient.resize(sourceOf.size());
+  thresholdGradient.resize(steps.size());
+}
+
+void GradientTuner::saveParameters(vector<double> &weights, vector<double> &thresholds) const {
+  weights.clear();
+  thresholds.clear();
+  for (auto &step : steps) {
+    for (auto i = step.oNode->cbegin(); i != step.oNode->cend(); i++) {
+      weights.push_back(i->weight);
+    }
+    thresholds.push_back(step.pNode ? step.pNode->getThreshold() : 0.0);
+  }
+}
+
+void GradientTuner::restoreParameters(vector<double> const &weights, vector<double> const &thresholds) {
+  for (size_t s = 0; s < steps.size(); s += 1) {
+    ONode &oNode = *steps[s].oNode;
+    for (size_t i = 0; i < oNode.size(); i += 1) {
+      oNode[i].weight = weights[firstInput[s] + i];
+    }
+    if (steps[s].pNode) {
+      steps[s].pNode->setThreshold(thresholds[s]);
+    }
+  }
+}
+
+// Evaluates every sample, as LevelEvaluator would, and adds its
+// gradient into weightGradient and thresholdGradient.  Returns the sum
+// squared error.
+
+double GradientTuner::accumulateGradient() {
+  std::fill(weightGradient.begin(), weightGradient.end(), 0.0);
+  std::fill(thresholdGradient.begin(), thresholdGradient.end(), 0.0);
+
+  double sumSquaredError = 0.0;
+  for (auto &sample : samples) {
+    for (size_t i = 0; i < INodes.size(); i += 1) {
+      INodes[i]->setValue(sample.inputs[i]);
+    }
+    for (auto &step : steps) {
+      step.oNode->Invalidate();
+    }
+    for (auto &step : steps) {
+      if (step.pNode) {
+	step.pNode->Evaluate();
+      } else {
+	step.oNode->Evaluate();
+      }
+    }
+
+    std::fill(adjoint.begin(), adjoint.end(), 0.0);
+    for (size_t s = steps.size(); 0 < s--; /* empty */) {
+      ONode *oNode = steps[s].oNode;
+      PNode *pNode = steps[s].pNode;
+      double o = oNode->Evaluate();
+
+      // d error / d o, the tanh()ed sum of our inputs.
+
+      double dO = 0.0;
+      if (pNode) {
+	double t = pNode->getThreshold();
+	if (t < 0.0 ? o < t : t < o) {
+	  dO = adjoint[s];
+	  thresholdGradient[s] -= adjoint[s];
+	} else {
+	  thresholdGradient[s] += adjoint[s];
+	}
+      } else if (outputOf[s] != none) {
+	double error = sample.target - o;
+	sumSquaredError += error * error;
+	dO = -2.0 * error;
+      }
+
+      double dSum = dO * (1.0 - o * o);
+      if (dSum == 0.0) {
+	continue;
+      }
+      for (size_t i = 0; i < oNode->size(); i += 1) {
+	Input &input = (*oNode)[i];
+	size_t n = firstInput[s] + i;
+	weightGradient[n] += dSum * input.iNode->Evaluate();
+	if (sourceOf[n] != none) {
+	  adjoint[sourceOf[n]] += dSum * input.weight;
+	}
+      }
+    }
+  }
+  return sumSquaredError;
+}
+
+double GradientTuner::Tune(size_t nSteps, double rate) {
+  double bestError = HUGE_VAL;
+  vector<double> bestWeights;
+  vector<double> bestThresholds;
+  double scale = rate / max(size_t(1), samples.size());
+
+  for (size_t step = 0; /* empty */; step += 1) {
+    double error = accumulateGradient();
+    if (error < bestError) {
+      bestError = error;
+      saveParameters(bestWeights, bestThresholds);
+    }
+    if (step == nSteps || std::isnan(error)) {
+      break;
+    }
+
+    for (size_t s = 0; s < steps.size(); s += 1) {
+      ONode &oNode = *steps[s].oNode;
+      for (size_t i = 0; i < oNode.size(); i += 1) {
+	oNode[i].weight -= scale * weightGradient[firstInput[s] + i];
+      }
+      if (steps[s].pNode) {
+	steps[s].pNode->setThreshold(steps[s].pNode->getThreshold() - scale * thresholdGradient[s]);
+      }
+    }
+  }
+
+  if (!bestWeights.empty() || !bestThresholds.empty()) {
+    restoreParameters(bestWeights, bestThresholds);
+  }
+
+  // Leave nothing cached from the old weights for the evaluators.
+
+  for (auto &step : steps) {
+    step.oNode->Invalidate();
+  }
+  return bestError;
+}
+
+// A genome, and its network's error and costs: its size, and how long
+// it took to evaluate the samples, which is only an objective with
+// paretoTiming.  rank and crowding are set by rankByPareto().
+
+struct Individual {
+  Genome genome;
+  double error;
+  size_t nPNodes;
+  size_t nEdges;
+  double seconds;
+  size_t rank;
+  double crowding;
+
+  static size_t nObjectives() { return evolution.paretoTiming ? 4 : 3; }
+  double objective(size_t k) const {
+    switch (k) {
+    case 0:  return error;
+    case 1:  return nPNodes;
+    case 2:  return nEdges;
+    default: return seconds;
+    }
+  }
+  bool operator<(Individual const &that) const { return error < that.error; }
+  bool dominates(Individual const &that) const {
+    bool better = false;
+    for (size_t k = 0; k < nObjectives(); k += 1) {
+      if (that.objective(k) < objective(k)) {
+	return false;
+      }
+      better = better || objective(k) < that.objective(k);
+    }
+    return better;
+  }
+};
+
+// Develops, prunes and scores a genome, leaving its network in INodes,
+// ONodes and PNodes.
+
+Individual scoreGenome(Genome genome, WorkerPool &pool, vector<Sample> const &samples) {
+  seedNetwork(genome.get());
+  developNetwork();
+  pruneNetwork(pool, true);
+  if (evolution.gradientSteps) {
+    GradientTuner(samples).Tune(evolution.gradientSteps, evolution.gradientRate);
+  }
+
+  Individual individual = { std::move(genome), HUGE_VAL, PNodes.size(), countEdges(), 0.0, 0, 0.0 };
+
+  Evaluator *evaluator = newEvaluator(pool);
+  auto start = std::chrono::steady_clock::now();
+  individual.error = sumSquaredError(*evaluator, samples);
+  individual.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  delete evaluator;
+  return individual;
+}
+
+// What SurrogateModel sees of a genome, without developing it in full:
+// the share of its nodes of each kind, its size and depth, how many Ser
+// and Par nodes it has, and how its network stands after the first
+// surrogateCycles development cycles.  Leaves that partial network in
+// INodes, ONodes and PNodes.
+
+size_t const nGenomeFeatures = 1 + EoKind + 8;
+
+void genomeFeatures(GNode *genome, vector<double> &features) {
+  vector<GNode const *> nodes;
+  genome->collectNodes(nodes);
+  vector<size_t> nKind(EoKind, 0);
+  for (auto &n : nodes) {
+    nKind[n->getKind()] += 1;
+  }
+
+  features.assign(1, 1.0);
+  for (auto k = Ser; k < EoKind; k = GKind(int(k) + 1)) {
+    features.push_back(double(nKind[k]) / nodes.size());
+  }
+  features.push_back(log1p(nodes.size()));
+  features.push_back(log1p(genome->depth()));
+  features.push_back(log1p(nKind[Ser]));
+  features.push_back(log1p(nKind[Par]));
+
+  seedNetwork(genome);
+  bool isDone = false;
+  for (size_t cycle = 0; !isDone && cycle < evolution.surrogateCycles; cycle += 1) {
+    isDone = developCycle();
+  }
+  size_t nGrowing = 0;
+  for (auto &p : PNodes) {
+    nGrowing += p->hasMore() ? 1 : 0;
+  }
+  features.push_back(log1p(PNodes.size()));
+  features.push_back(log1p(countEdges()));
+  features.push_back(PNodes.empty() ? 0.0 : double(nGrowing) / PNodes.size());
+  features.push_back(isDone ? 1.0 : 0.0);
+}
+
+// A linear model of log(1 + error), fitted online by recursive least
+// squares from a ridge prior.  Old observations are slowly forgotten,
+// as the population, and so what makes an offspring competitive,
+// moves on.
+
+class SurrogateModel {
+public:
+  SurrogateModel(size_t _nFeatures, double ridge = 1.0, double _forgetting = 0.995) :
+    nFeatures(_nFeatures),
+    forgetting(_forgetting),
+    weights(_nFeatures, 0.0),
+    covariance(_nFeatures * _nFeatures, 0.0),
+    nTrained(0)
+  {
+    for (size_t i = 0; i < nFeatures; i += 1) {
+      covariance[i * nFeatures + i] = 1.0 / ridge;
+    }
+  }
+  size_t getNTrained() const { return nTrained; }
+  double Predict(vector<double> const &features) const {
+    double prediction = 0.0;
+    for (size_t i = 0; i < nFeatures; i += 1) {
+      prediction += weights[i] * features[i];
+    }
+    return prediction;
+  }
+  void Train(vector<double> const &features, double target) {
+    vector<double> gain(nFeatures, 0.0);
+    double denominator = forgetting;
+    for (size_t i = 0; i < nFeatures; i += 1) {
+      for (size_t j = 0; j < nFeatures; j += 1) {
+	gain[i] += covariance[i * nFeatures + j] * features[j];
+      }
+      denominator += features[i] * gain[i];
+    }
+
+    double error = target - Predict(features);
+    for (size_t i = 0; i < nFeatures; i += 1) {
+      gain[i] /= denominator;
+      weights[i] += gain[i] * error;
+    }
+    // The covariance is symmetric, so gain * features' * covariance is
+    // gain * (covariance * features)' = gain * gain' * denominator.
+    for (size_t i = 0; i < nFeatures; i += 1) {
+      for (size_t j = 0; j < nFeatures; j += 1) {
+	double &c = covariance[i * nFeatures + j];
+	c = (c - gain[i] * gain[j] * denominator) / forgetting;
+      }
+    }
+    nTrained += 1;
+  }
+
+private:
+  size_t nFeatures;
+  double forgetting;
+  vector<double> weights;
+  vector<double> covariance;
+  size_t nTrained;
+};
+
+double randomUnit() {
+  return rand() / (RAND_MAX + 1.0);
+}
+
+// Replaces a random subtree of the genome (possibly all of it) with a
+// freshly grown one.
+
+void mutate(Genome &genome) {
+  vector<GNode **> links(1, 0);
+  genome->collectLinks(links);
+
+  GNode **link = links[rand() % links.size()];
+  if (!link) {
+    genome.reset(buildRandom(evolution.mutationDepth));
+    return;
+  }
+  delete *link;
+  *link = buildRandom(evolution.mutationDepth);
+}
+
+// A copy of mother, with a random subtree replaced by a copy of one of
+// father's.
+
+Genome crossover(GNode const *mother, GNode const *father) {
+  Genome child(mother->clone());
+  vector<GNode **> links(1, 0);
+  child->collectLinks(links);
+  vector<GNode const *> donors;
+  father->collectNodes(donors);
+
+  GNode **link = links[rand() % links.size()];
+  GNode *donor = donors[rand() % donors.size()]->clone();
+  if (!link) {
+    child.reset(donor);
+  } else {
+    delete *link;
+    *link = donor;
+  }
+  return child;
+}
+
+// Sets each individual's crowding distance within its front: how far
+// apart, summed over the objectives, its neighbours in the front lie.
+// The front's extremes are infinitely far from crowded.
+
+void setCrowding(vector<Individual> &population, vector<size_t> front) {
+  for (auto &f : front) {
+    population[f].crowding = 0.0;
+  }
+  for (size_t k = 0; k < Individual::nObjectives(); k += 1) {
+    std::sort(front.begin(), front.end(), [&population, k](size_t a, size_t b) {
+	return population[a].objective(k) < population[b].objective(k);
+      });
+    double lo = population[front.front()].objective(k);
+    double hi = population[front.back()].objective(k);
+    population[front.front()].crowding = HUGE_VAL;
+    population[front.back()].crowding = HUGE_VAL;
+    if (!(lo < hi) || std::isinf(hi - lo)) {
+      continue;
+    }
+    for (size_t f = 1; f + 1 < front.size(); f += 1) {
+      double gap = population[front[f + 1]].objective(k) - population[front[f - 1]].objective(k);
+      population[front[f]].crowding += gap / (hi - lo);
+    }
+  }
+}
+
+// NSGA-II's non-dominated sort: ranks the population into fronts, rank
+// 0 being the individuals that nothing dominates, rank 1 those that only
+// rank 0 individuals dominate, and so on, and sorts it by rank, the
+// least crowded first within each.
+
+void rankByPareto(vector<Individual> &population) {
+  size_t n = population.size();
+  vector<vector<size_t>> dominated(n);
+  vector<size_t> nDominators(n, 0);
+  for (size_t p = 0; p < n; p += 1) {
+    for (size_t q = p + 1; q < n; q += 1) {
+      if (population[p].dominates(population[q])) {
+	dominated[p].push_back(q);
+	nDominators[q] += 1;
+      } else if (population[q].dominates(population[p])) {
+	dominated[q].push_back(p);
+	nDominators[p] += 1;
+      }
+    }
+  }
+
+  vector<size_t> front;
+  for (size_t p = 0; p < n; p += 1) {
+    if (nDominators[p] == 0) {
+      front.push_back(p);
+    }
+  }
+  for (size_t rank = 0; !front.empty(); rank += 1) {
+    vector<size_t> next;
+    for (auto &p : front) {
+      population[p].rank = rank;
+      for (auto &q : dominated[p]) {
+	if (--nDominators[q] == 0) {
+	  next.push_back(q);
+	}
+      }
+    }
+    setCrowding(population, front);
+    front.swap(next);
+  }
+
+  std::stable_sort(population.begin(), population.end(), [](Individual const &a, Individual const &b) {
+      return a.rank < b.rank || (a.rank == b.rank && b.crowding < a.crowding);
+    });
+}
+
+// Orders the population best first, as the selection calls for.
+
+void sortPopulation(vector<Individual> &population) {
+  if (evolution.paretoSelection) {
+    rankByPareto(population);
+  } else {
+    std::stable_sort(population.begin(), population.end());
+  }
+}
+
+bool isFitter(Individual const &a, Individual const &b) {
+  if (evolution.paretoSelection) {
+    return a.rank < b.rank || (a.rank == b.rank && b.crowding < a.crowding);
+  }
+  return a < b;
+}
+
+Individual const &selectByTournament(vector<Individual> const &population) {
+  Individual const *winner = &population[rand() % population.size()];
+  for (size_t t = 1; t < evolution.tournamentSize; t += 1) {
+    Individual const *challenger = &population[rand() % population.size()];
+    if (isFitter(*challenger, *winner)) {
+      winner = challenger;
+    }
+  }
+  return *winner;
+}
+
+// Where islands swap migrants, and post their results: a block of
+// memory shared between the island processes, holding, for every pair
+// of islands, a single-producer single-consumer ring of genome slots.
+// The rings are lock-free, so an island never waits on another: it
+// drops migrants for a full ring, and takes whatever has arrived.
+
+class MigrationBoard {
+public:
+  MigrationBoard(size_t _nIslands, size_t _nSlots, size_t _slotBytes, size_t _nResults = 1);
+  ~MigrationBoard() {
+    if (isMapped()) {
+      munmap(memory, nBytes);
+    }
+  }
+  bool isMapped() const { return memory != MAP_FAILED; }
+  bool Send(size_t from, size_t to, Individual const &migrant);
+  bool Receive(size_t from, size_t to, Individual &migrant);
+  void PostResults(size_t island, vector<Individual const *> const &results);
+  void getResults(size_t island, vector<Individual> &results);
+
+private:
+  static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared rings need address-free atomics");
+
+  struct Ring {
+    atomic<uint32_t> head;
+    atomic<uint32_t> tail;
+  };
+  struct Slot {
+    uint32_t size;
+    double error;
+    size_t nPNodes;
+    size_t nEdges;
+    double seconds;
+  };
+
+  static size_t roundUp(size_t n) { return (n + 63) & ~size_t(63); }
+  Ring *ring(size_t from, size_t to) {
+    return reinterpret_cast<Ring *>(static_cast<char *>(memory) + (from * nIslands + to) * ringBytes);
+  }
+  Slot *slot(Ring *ring, uint32_t n) {
+    return reinterpret_cast<Slot *>(reinterpret_cast<char *>(ring) + roundUp(sizeof(Ring)) + (n % nSlots) * slotBytes);
+  }
+  Slot *result(size_t island, size_t r) {
+    return reinterpret_cast<Slot *>(static_cast<char *>(memory) + nIslands * nIslands * ringBytes + (island * nResults + r) * slotBytes);
+  }
+  bool put(Slot *slot, Individual const &individual);
+  bool get(Slot *slot, Individual &individual);
+
+  size_t nIslands;
+  size_t nSlots;
+  size_t slotBytes;
+  size_t ringBytes;
+  size_t nResults;
+  size_t nBytes;
+  void *memory;
+};
+
+MigrationBoard::MigrationBoard(size_t _nIslands, size_t _nSlots, size_t _slotBytes, size_t _nResults) :
+  nIslands(_nIslands),
+  nSlots(_nSlots),
+  slotBytes(roundUp(sizeof(Slot) + _slotBytes)),
+  ringBytes(roundUp(sizeof(Ring)) + _nSlots * slotBytes),
+  nResults(_nResults),
+  nBytes(nIslands * nIslands * ringBytes + nIslands * nResults * slotBytes)
+{
+  memory = mmap(0, nBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (!isMapped()) {
+    cerr << "MigrationBoard: can't map " << nBytes << " bytes\n";
+    return;
+  }
+  for (size_t from = 0; from < nIslands; from += 1) {
+    for (size_t to = 0; to < nIslands; to += 1) {
+      Ring *r = ring(from, to);
+      new (&r->head) atomic<uint32_t>(0);
+      new (&r->tail) atomic<uint32_t>(0);
+    }
+  }
+  for (size_t island = 0; island < nIslands; island += 1) {
+    for (size_t r = 0; r < nResults; r += 1) {
+      result(island, r)->size = 0;
+    }
+  }
+}
+
+bool MigrationBoard::put(Slot *slot, Individual const &individual) {
+  string bytes;
+  individual.genome->serialize(bytes);
+  if (slotBytes - sizeof(Slot) < bytes.size()) {
+    return false;
+  }
+  slot->size = bytes.size();
+  slot->error = individual.error;
+  slot->nPNodes = individual.nPNodes;
+  slot->nEdges = individual.nEdges;
+  slot->seconds = individual.seconds;
+  memcpy(slot + 1, bytes.data(), bytes.size());
+  return true;
+}
+
+bool MigrationBoard::get(Slot *slot, Individual &individual) {
+  if (slot->size == 0) {
+    return false;
+  }
+  char const *bytes = reinterpret_cast<char const *>(slot + 1);
+  individual.genome.reset(GNode::deserialize(bytes, bytes + slot->size));
+  individual.error = slot->error;
+  individual.nPNodes = slot->nPNodes;
+  individual.nEdges = slot->nEdges;
+  individual.seconds = slot->seconds;
+  return bool(individual.genome);
+}
+
+bool MigrationBoard::Send(size_t from, size_t to, Individual const &migrant) {
+  Ring *r = ring(from, to);
+  uint32_t head = r->head.load(std::memory_order_relaxed);
+  if (head - r->tail.load(std::memory_order_acquire) == nSlots) {
+    return false;
+  }
+  if (!put(slot(r, head), migrant)) {
+    return false;
+  }
+  r->head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+bool MigrationBoard::Receive(size_t from, size_t to, Individual &migrant) {
+  Ring *r = ring(from, to);
+  uint32_t tail = r->tail.load(std::memory_order_relaxed);
+  if (tail == r->head.load(std::memory_order_acquire)) {
+    return false;
+  }
+  bool received = get(slot(r, tail), migrant);
+  r->tail.store(tail + 1, std::memory_order_release);
+  return received;
+}
+
+// Genomes too big for a slot are left out.
+
+void MigrationBoard::PostResults(size_t island, vector<Individual const *> const &results) {
+  size_t r = 0;
+  for (auto &individual : results) {
+    if (r < nResults && put(result(island, r), *individual)) {
+      r += 1;
+    }
+  }
+}
+
+void MigrationBoard::getResults(size_t island, vector<Individual> &results) {
+  for (size_t r = 0; r < nResults; r += 1) {
+    Individual individual = { Genome(), HUGE_VAL, 0, 0, 0.0, 0, 0.0 };
+    if (get(result(island, r), individual)) {
+      results.push_back(std::move(individual));
+    }
+  }
+}
+
+// Swaps migrants with the island's neighbours; the population must be
+// sorted, best first.  Arrivals replace the worst of the population.
+
+void migrate(size_t island, vector<Individual> &population, MigrationBoard &board) {
+  vector<size_t> targets;
+  if (evolution.migrationTopology == "complete") {
+    for (size_t i = 0; i < evolution.nIslands; i += 1) {
+      if (i != island) {
+	targets.push_back(i);
+      }
+    }
+  } else if (evolution.migrationTopology == "random") {
+    targets.push_back((island + 1 + rand() % (evolution.nIslands - 1)) % evolution.nIslands);
+  } else {
+    targets.push_back((island + 1) % evolution.nIslands);
+  }
+
+  size_t nMigrants = min(evolution.migrationSize, population.size());
+  for (auto &to : targets) {
+    for (size_t m = 0; m < nMigrants; m += 1) {
+      board.Send(island, to, population[m]);
+    }
+  }
+
+  size_t replace = population.size();
+  for (size_t from = 0; from < evolution.nIslands; from += 1) {
+    Individual migrant;
+    while (from != island && board.Receive(from, island, migrant)) {
+      if (evolution.nElites < replace) {
+	replace -= 1;
+	population[replace] = std::move(migrant);
+      }
+    }
+  }
+  sortPopulation(population);
+}
+
+// Keeps the island under evolution.memoryCeiling, if it's set, and
+// returns the population size to keep to from now on.  The population
+// must be sorted, best first.  Dropping genomes can't shrink what the
+// network pool holds on to, so none are dropped while that alone is
+// over the ceiling.
+
+size_t enforceMemoryCeiling(vector<Individual> &population, size_t populationSize) {
+  if (!evolution.memoryCeiling || measureMemory().totalBytes() <= evolution.memoryCeiling) {
+    return populationSize;
+  }
+
+  networkPool.Trim();
+  size_t minimum = max(size_t(2), evolution.nElites + 1);
+  for (MemoryUsage usage = measureMemory();
+       evolution.memoryCeiling < usage.totalBytes() && usage.reservedBytes < evolution.memoryCeiling && minimum < population.size();
+       usage = measureMemory()) {
+    population.pop_back();
+  }
+  return min(populationSize, population.size());
+}
+
+// Evolves one island's population, migrating through the board, and
+// posts its best genome there, or with paretoSelection, its Pareto
+// front.
+
+void evolveIsland(size_t island, MigrationBoard &board, vector<Sample> const &samples, WorkerPool &pool) {
+  SurrogateModel surrogate(nGenomeFeatures);
+  vector<double> features;
+  auto score = [&](Genome genome) {
+    if (evolution.surrogateScreening && features.empty()) {
+      genomeFeatures(genome.get(), features);
+    }
+    Individual individual = scoreGenome(std::move(genome), pool, samples);
+    if (evolution.surrogateScreening && std::isfinite(individual.error)) {
+      surrogate.Train(features, log1p(individual.error));
+    }
+    features.clear();
+    return individual;
+  };
+
+  size_t populationSize = evolution.populationSize;
+  vector<Individual> population;
+  for (size_t i = 0; i < populationSize; i += 1) {
+    population.push_back(score(Genome(buildRandom(0))));
+  }
+  sortPopulation(population);
+
+  for (size_t generation = 1; generation <= evolution.nGenerations; generation += 1) {
+    // Offspring the surrogate predicts won't beat this are screened out,
+    // up to a limit, so a generation always fills.
+
+    double cutoff = HUGE_VAL;
+    size_t nScreenedOut = 0;
+    if (evolution.surrogateScreening && evolution.surrogateWarmup <= surrogate.getNTrained()) {
+      vector<double> errors;
+      for (auto &individual : population) {
+	errors.push_back(individual.error);
+      }
+      size_t q = min(errors.size() - 1, size_t(evolution.surrogateQuantile * errors.size()));
+      std::nth_element(errors.begin(), errors.begin() + q, errors.end());
+      cutoff = log1p(errors[q]);
+    }
+
+    vector<Individual> offspring;
+    for (size_t e = 0; !evolution.paretoSelection && e < min(evolution.nElites, population.size()); e += 1) {
+      Individual const &elite = population[e];
+      offspring.push_back({ Genome(elite.genome->clone()), elite.error, elite.nPNodes, elite.nEdges, elite.seconds, 0, 0.0 });
+    }
+    while (offspring.size() < populationSize) {
+      Individual const &mother = selectByTournament(population);
+      Genome child;
+      if (randomUnit() < evolution.crossoverRate) {
+	child = crossover(mother.genome.get(), selectByTournament(population).genome.get());
+      } else {
+	child.reset(mother.genome->clone());
+      }
+      if (randomUnit() < evolution.mutationRate) {
+	mutate(child);
+      }
+      if (evolution.maxGenomeNodes < child->countNodes()) {
+	child.reset(mother.genome->clone());
+      }
+      if (cutoff < HUGE_VAL && nScreenedOut < 4 * populationSize) {
+	genomeFeatures(child.get(), features);
+	if (evolution.surrogateExploration <= randomUnit() && cutoff < surrogate.Predict(features)) {
+	  features.clear();
+	  nScreenedOut += 1;
+	  continue;
+	}
+      }
+      offspring.push_back(score(std::move(child)));
+    }
+    if (evolution.paretoSelection) {
+      // NSGA-II: parents and offspring compete for places, front by
+      // front, and the last front to fit is cut by crowding.
+
+      population.insert(population.end(), std::make_move_iterator(offspring.begin()), std::make_move_iterator(offspring.end()));
+      rankByPareto(population);
+      population.resize(populationSize);
+    } else {
+      population.swap(offspring);
+      std::stable_sort(population.begin(), population.end());
+    }
+    offspring.clear(); // Now the last generation, which the ceiling mustn't count.
+
+    if (1 < evolution.nIslands && evolution.migrationInterval && generation % evolution.migrationInterval == 0) {
+      migrate(island, population, board);
+    }
+    populationSize = enforceMemoryCeiling(population, populationSize);
+
+    Individual const &best = *std::min_element(population.begin(), population.end());
+    cout << "island " << island
+	 << " generation " << generation
+	 << ": sumSquaredError = " << best.error
+	 << ", " << best.nPNodes << " PNodes"
+	 << ", " << best.nEdges << " edges"
+	 << ", " << best.genome->countNodes() << " genome nodes";
+    if (evolution.paretoSelection) {
+      cout << ", front of " << std::count_if(population.begin(), population.end(), [](Individual const &i) { return i.rank == 0; });
+    }
+    if (evolution.surrogateScreening) {
+      cout << ", " << nScreenedOut << " screened out";
+    }
+    if (populationSize < evolution.populationSize) {
+      cout << ", population cut to " << populationSize;
+    }
+    cout << "\n";
+    if (evolution.memoryReport) {
+      cout << "island " << island << " generation " << generation << " memory: " << measureMemory().toString() << "\n";
+    }
+    cout << std::flush;
+  }
+
+  vector<Individual const *> results(1, &population[0]);
+  if (evolution.paretoSelection) {
+    results.clear();
+    for (auto &individual : population) {
+      if (individual.rank == 0) {
+	results.push_back(&individual);
+      }
+    }
+  }
+  board.PostResults(island, results);
+}
+
+// Develops a genome's network again, and exports it with
+// CompiledEvaluator::Build().
+
+bool exportNetwork(GNode const *genome, string const &stem, WorkerPool &pool, vector<Sample> const &samples) {
+  scoreGenome(Genome(genome->clone()), pool, samples);
+  if (!CompiledEvaluator::Build(stem)) {
+    return false;
+  }
+  cout << "exported " << stem << ".so\n";
+  return true;
+}
+
+// Evolves evolution.nIslands populations, each in a process of its
+// own, so that they share nothing but the migration board.  Each island
+// gets an even share of the evaluation threads.
+
+int runIslands(int seed, double &bestError) {
+  vector<Sample> samples = makeSamples(evolution.nSamples);
+  MigrationBoard board(evolution.nIslands, evolution.migrationSlots, evolution.migrationSlotBytes,
+		       evolution.paretoSelection ? evolution.populationSize : 1);
+  if (!board.isMapped()) {
+    return 1;
+  }
+
+  cout << std::flush;
+  vector<pid_t> islands;
+  for (size_t island = 0; island < evolution.nIslands; island += 1) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      srand(seed + 1 + island);
+      {
+	WorkerPool pool(max(size_t(1), nEvaluationThreads / evolution.nIslands));
+	evolveIsland(island, board, samples, pool);
+      }
+      cout << std::flush;
+      _exit(0);
+    }
+    if (pid < 0) {
+      cerr << "runIslands: can't fork island " << island << "\n";
+      for (auto &i : islands) {
+	kill(i, SIGTERM);
+      }
+      break;
+    }
+    islands.push_back(pid);
+  }
+
+  int status = islands.size() == evolution.nIslands ? 0 : 1;
+  for (auto &i : islands) {
+    int islandStatus;
+    if (waitpid(i, &islandStatus, 0) < 0 || !WIFEXITED(islandStatus) || WEXITSTATUS(islandStatus) != 0) {
+      cerr << "runIslands: island process " << i << " failed\n";
+      status = 1;
+    }
+  }
+
+  vector<Individual> results;
+  for (size_t island = 0; island < islands.size(); island += 1) {
+    size_t r = results.size();
+    board.getResults(island, results);
+    if (r < results.size()) {
+      cout << "island " << island << ": sumSquaredError = "
+	   << std::min_element(results.begin() + r, results.end())->error << "\n";
+    }
+  }
+  if (results.empty()) {
+    return status;
+  }
+
+  vector<GNode const *> toExport;
+  if (evolution.paretoSelection) {
+    rankByPareto(results);
+    vector<Individual const *> front;
+    for (auto &individual : results) {
+      if (individual.rank == 0) {
+	front.push_back(&individual);
+      }
+    }
+    std::stable_sort(front.begin(), front.end(), [](Individual const *a, Individual const *b) { return *a < *b; });
+    cout << "Pareto front: {\n";
+    vector<string> shown;
+    for (auto &i : front) {
+      Individual const &individual = *i;
+      // Migrants can leave copies of a genome on several islands.
+
+      string genome = individual.genome->toString();
+      if (find(shown.begin(), shown.end(), genome) != shown.end()) {
+	continue;
+      }
+      shown.push_back(genome);
+      toExport.push_back(individual.genome.get());
+      cout << "    sumSquaredError = " << individual.error
+	   << ", " << individual.nPNodes << " PNodes"
+	   << ", " << individual.nEdges << " edges";
+      if (evolution.paretoTiming) {
+	cout << ", " << individual.seconds << " seconds";
+      }
+      cout << ": " << genome << "\n";
+    }
+    cout << "}\n";
+  }
+
+  Individual const &best = *std::min_element(results.begin(), results.end());
+  bestError = best.error;
+  cout << "best: sumSquaredError = " << best.error << "\n";
+  cout << "best genome = " << best.genome->toString() << "\n";
+
+  if (!exportNetworkStem.empty()) {
+    WorkerPool pool(nEvaluationThreads);
+    if (!exportNetwork(best.genome.get(), exportNetworkStem, pool, samples)) {
+      status = 1;
+    }
+    for (size_t e = 0; e < toExport.size(); e += 1) {
+      ostringstream stem;
+      stem << exportNetworkStem << "-" << e;
+      if (!exportNetwork(toExport[e], stem.str(), pool, samples)) {
+	status = 1;
+      }
+    }
+  }
+  return status;
+}
+
+// Scores the network exported to loadNetworkPath against the samples
+// that evolving with the same seed would use.
+
+int runLoadedNetwork(double &bestError) {
+  vector<Sample> samples = makeSamples(evolution.nSamples);
+  CompiledEvaluator evaluator(loadNetworkPath);
+  if (!evaluator.isLoaded()) {
+    return 1;
+  }
+  if (evaluator.getNInputs() != nNetworkInputs) {
+    cerr << loadNetworkPath << " takes " << evaluator.getNInputs() << " inputs, not "
+	 << nNetworkInputs << "\n";
+    return 1;
+  }
+  bestError = sumSquaredError(evaluator, samples);
+  cout << loadNetworkPath << ": sumSquaredError = " << bestError << "\n";
+  return 0;
+}
+
+// Develops, prunes and scores nGenomesPerRun random genomes, printing
+// every sample, and returns the least sumSquaredError.
+
+double runGenomes(WorkerPool &workerPool) {
+  double bestError = HUGE_VAL;
+
+  vector<Genome> genomes(nGenomesPerRun);
+  for (size_t i = 0; i < genomes.size(); i += 1) {
+    genomes[i].reset(buildRandom(0));
+    cout << "genomes[" << i << "] = " << genomes[i]->toString() << "\n";
+
+    seedNetwork(genomes[i].get());
+
+    Dump();
+
+    developNetwork();
+
+    pruneNetwork(workerPool);
+
+    if (!INodes.empty() && !ONodes.empty() && !PNodes.empty()) {
+      Evaluator *evaluator = newEvaluator(workerPool);
+
+      vector<double> inputs(INodes.size());
+      vector<double> outputs(ONodes.size());
+      double sumSquaredError = 0.0;
+      for (size_t t = 0; t < nSamplesPerGenome; t += 1) {
+	double mean = 0.0;
+	for (size_t i = 0; i < INodes.size(); i += 1) {
+	  double value = rand() % 11 - 5;
+	  inputs[i] = value;
+	  mean += value;
+	}
+	mean /= INodes.size();
+
+	evaluator->Evaluate(inputs, outputs);
+
+	char const *comma = "{";
+	for (auto &value : inputs) {
+	  cout << comma << " " << value;
+	  comma = ",";
+	}
+	cout << " } (" << mean << ") -> ";
+	comma = "{";
+	for (auto &result : outputs) {
+	  cout << comma << " " << result;
+	  comma = ",";
+
+	  double error = mean - result;
+	  sumSquaredError += error * error;
+	}
+	cout << " }\n";
+      }
+      delete evaluator;
+
+      cout << "sumSquaredError = " << sumSquaredError << "\n\n";
+      bestError = min(bestError, sumSquaredError);
+    }
+
+    Dump();
+  }
+
+  return bestError;
 }
 
-int main(int argc, char const *argv[]) {
-  int seed = time(0);
-  cout << "Seed = " << seed << "\n", srand(seed);
+// Describes the current network's topology, weights and thresholds,
+// one node per line, naming nodes by their place in INodes, ONodes and
+// PNodes, so that two developments of a genome can be compared.
 
-  array<GNode *, 10> genomes;
-  for (size_t i = 0; i < genomes.size(); i += 1) {
-    genomes[i] = buildRandom(0);
-    cout << "genomes[" << i << "] = " << genomes[i]->toString() << "\n";
+string snapshotNetwork() {
+  unordered_map<void const *, string> nameOf;
+  for (size_t i = 0; i < INodes.size(); i += 1) {
+    nameOf[INodes[i]] = "i" + std::to_string(i);
+  }
+  for (size_t o = 0; o < ONodes.size(); o += 1) {
+    nameOf[ONodes[o]] = "o" + std::to_string(o);
+  }
+  for (size_t p = 0; p < PNodes.size(); p += 1) {
+    nameOf[static_cast<INode *>(PNodes[p])] = "p" + std::to_string(p);
+    nameOf[static_cast<ONode *>(PNodes[p])] = "p" + std::to_string(p);
+  }
+  auto name = [&nameOf](void const *node) {
+    auto n = nameOf.find(node);
+    return n != nameOf.end() ? n->second : string("?");
+  };
 
-    for (auto &o : ONodes) {
-      delete o;
+  ostringstream s;
+  auto inputs = [&s, &name](ONode const *oNode) {
+    s << " in:";
+    for (auto i = oNode->cbegin(); i != oNode->cend(); i++) {
+      s << " " << name(i->iNode) << "*" << toLiteral(i->weight);
     }
-    ONodes.clear();
+  };
+  auto outputs = [&s, &name](INode const *iNode) {
+    s << " out:";
+    for (auto o = iNode->cbegin(); o != iNode->cend(); o++) {
+      s << " " << name(*o);
+    }
+  };
+  for (size_t i = 0; i < INodes.size(); i += 1) {
+    s << "i" << i;
+    outputs(INodes[i]);
+    s << "\n";
+  }
+  for (size_t o = 0; o < ONodes.size(); o += 1) {
+    s << "o" << o;
+    inputs(ONodes[o]);
+    s << "\n";
+  }
+  for (size_t p = 0; p < PNodes.size(); p += 1) {
+    PNode const *pNode = PNodes[p];
+    s << "p" << p
+      << " threshold " << toLiteral(pNode->getThreshold())
+      << " iLink " << pNode->getILink()
+      << " oLink " << pNode->getOLink();
+    inputs(pNode);
+    outputs(pNode);
+    s << "\n";
+  }
+  return s.str();
+}
 
-    ONodes.push_back(new ONode());
+// The first line at which two snapshots differ.
 
-    for (auto &i : INodes) {
-      delete i;
+string firstDifference(string const &expected, string const &actual) {
+  std::istringstream e(expected);
+  std::istringstream a(actual);
+  string eLine;
+  string aLine;
+  while (true) {
+    bool eMore = bool(std::getline(e, eLine));
+    bool aMore = bool(std::getline(a, aLine));
+    if (!eMore && !aMore) {
+      return "";
     }
-    INodes.clear();
+    if (!eMore || !aMore || eLine != aLine) {
+      return "expected \"" + (eMore ? eLine : string("(end)")) + "\", got \"" + (aMore ? aLine : string("(end)")) + "\"";
+    }
+  }
+}
 
-    INodes.push_back(new INode());
-    INodes.push_back(new INode());
-    INodes.push_back(new INode());
+// Checks every other way of developing and evaluating a genome against
+// the reference, PNode::Grow() cycle by cycle and LevelEvaluator on a
+// single thread, which never recurses more than a call deep however
+// long the network's chains are: the developers must build exactly the
+// same network, and each evaluator must match the reference outputs to
+// within its tolerance, relative to the larger of 1 and the reference's
+// magnitude.  RecursiveEvaluator and IncrementalEvaluator, which both
+// recurse, are only checked on networks that newEvaluator() would give
+// them.  Returns a description of the first mismatch, starting with the
+// path's name, or an empty string if everything agrees.
 
-    for (auto &i : INodes) {
-      i->setValue(0);
+double recursiveTolerance = 0.0;
+double incrementalTolerance = 0.0;
+double levelTolerance = 0.0;
+double compiledTolerance = 1e-12;
+
+string diffGenome(GNode *genome, WorkerPool &pool, vector<Sample> const &samples) {
+  seedNetwork(genome);
+  while (!developCycle()) {
+  }
+  string reference = snapshotNetwork();
+
+  seedNetwork(genome);
+  DevelopmentVM(genome).Develop();
+  string difference = firstDifference(reference, snapshotNetwork());
+  if (!difference.empty()) {
+    return "vm development: " + difference;
+  }
+
+  seedNetwork(genome);
+  while (!developCycle()) {
+  }
+  pruneNetwork(pool, true);
+
+  vector<vector<double>> expected(samples.size());
+  {
+    WorkerPool serial(1);
+    LevelEvaluator reference(serial, 1);
+    for (size_t t = 0; t < samples.size(); t += 1) {
+      reference.Evaluate(samples[t].inputs, expected[t]);
     }
+  }
 
-    for (auto &p : PNodes) {
-      delete p;
+  auto compare = [&](Evaluator &evaluator, double tolerance) {
+    vector<double> outputs;
+    for (size_t t = 0; t < samples.size(); t += 1) {
+      evaluator.Evaluate(samples[t].inputs, outputs);
+      for (size_t o = 0; o < outputs.size(); o += 1) {
+	double e = expected[t][o];
+	double a = outputs[o];
+	bool agree = (std::isnan(e) && std::isnan(a)) || e == a || std::abs(a - e) <= tolerance * max(1.0, std::abs(e));
+	if (!agree) {
+	  ostringstream s;
+	  s.precision(17);
+	  s << evaluator.Name() << " evaluation: sample " << t << ", output " << o << ": expected " << e << ", got " << a;
+	  return s.str();
+	}
+      }
     }
-    PNodes.clear();
+    return string();
+  };
 
-    PNodes.push_back(new PNode(ONodes, INodes, 0, 0, genomes[i], genomes[i]));
+  if (PNodes.size() < levelEvaluationThreshold) {
+    RecursiveEvaluator recursive;
+    difference = compare(recursive, recursiveTolerance);
+  }
+  if (difference.empty() && PNodes.size() < levelEvaluationThreshold) {
+    IncrementalEvaluator incremental;
+    difference = compare(incremental, incrementalTolerance);
+  }
+  if (difference.empty()) {
+    LevelEvaluator level(pool, 1);
+    difference = compare(level, levelTolerance);
+  }
+  if (difference.empty() && compiledEvaluation) {
+    if (CompiledEvaluator *compiled = CompiledEvaluator::Compile(compiledNetworkStem)) {
+      difference = compare(*compiled, compiledTolerance);
+      delete compiled;
+    } else {
+      difference = "compiled evaluation: couldn't compile the network";
+    }
+  }
+  return difference;
+}
 
-    Dump();
+// Replaces the l'th subtree of the genome, in preorder (0 being the
+// whole genome), with an End, or with its own first or second child
+// (how = 0, 1 or 2).  Returns false if there's no such child.
 
-    bool isDone = false;
-    for (size_t cycle = 0; !isDone; cycle += 1) {
-      size_t hasMore = 0;
-      size_t nPNodes = PNodes.size();
+bool replaceSubtree(Genome &genome, size_t l, int how) {
+  vector<GNode **> links(1, 0);
+  genome->collectLinks(links);
+  GNode *subtree = l == 0 ? genome.get() : *links[l];
+  GNode *child = how == 1 ? subtree->getNext() : how == 2 ? subtree->getSibling() : 0;
+  if (how != 0 && !child) {
+    return false;
+  }
 
-      for (size_t p = 0; p < nPNodes; p += 1) {
-	PNode *pNode = PNodes[p];
+  GNode *replacement = child ? child->clone() : new GNode(End);
+  if (l == 0) {
+    genome.reset(replacement);
+  } else {
+    delete *links[l];
+    *links[l] = replacement;
+  }
+  return true;
+}
 
-	if (pNode->hasMore()) {
-	  // cout << "# Growing by "
-	  //      << ::toString(pNode->getKind())
-	  //      << ": "
-	  //      << pNode->toString()
-	  //      << "\n";
+// Greedily shrinks a genome while it still fails the same way: tries
+// cutting each subtree, largest first, down to an End or to one of its
+// children, and starts over after each cut that keeps the failure.
 
-	  if (!pNode->Grow()) {
-	    hasMore += 1;
-	  }
+Genome shrinkGenome(Genome genome, function<bool(GNode *)> const &fails, size_t maxTries = 5000) {
+  size_t nTries = 0;
+  for (bool shrunk = true; shrunk && nTries < maxTries; /* empty */) {
+    shrunk = false;
+    size_t nNodes = genome->countNodes();
+    for (size_t l = 0; !shrunk && l < nNodes && nTries < maxTries; l += 1) {
+      for (int how = 0; !shrunk && how < 3; how += 1) {
+	Genome candidate(genome->clone());
+	if (!replaceSubtree(candidate, l, how) || nNodes <= candidate->countNodes()) {
+	  continue;
+	}
+	nTries += 1;
+	if (fails(candidate.get())) {
+	  genome = std::move(candidate);
+	  shrunk = true;
 	}
       }
+    }
+  }
+  return genome;
+}
+
+// Runs diffGenome() over nGenomes random genomes, the g'th built right
+// after srand(seed + g) so it can be rebuilt alone, and shrinks each
+// one that fails to a minimal reproducer.  Returns the number of
+// failures.
 
-      // cout << "# "
-      // 	   << cycle
-      // 	   << " ------------------------------------------------------------------------\n";
-      // Dump();
+size_t runDiffTest(int seed, size_t nGenomes) {
+  WorkerPool pool(max(size_t(2), nEvaluationThreads));
+  vector<Sample> samples = makeSamples(evolution.nSamples);
 
-      isDone = 0 == hasMore && nPNodes == PNodes.size();
+  size_t nFailures = 0;
+  for (size_t g = 0; g < nGenomes; g += 1) {
+    srand(seed + g);
+    Genome genome(buildRandom(0));
+    string difference = diffGenome(genome.get(), pool, samples);
+    if (difference.empty()) {
+      continue;
     }
 
-    for (auto &o : ONodes) {
-      double oValue = o->Evaluate();
+    nFailures += 1;
+    cout << "diff-test: genome " << g << " (seed " << seed + g << "), "
+	 << genome->countNodes() << " nodes: " << difference << "\n" << std::flush;
+
+    string path = difference.substr(0, difference.find(':'));
+    Genome reproducer = shrinkGenome(std::move(genome), [&](GNode *candidate) {
+	string candidateDifference = diffGenome(candidate, pool, samples);
+	return candidateDifference.compare(0, path.size(), path) == 0;
+      });
+    cout << "diff-test: reduced to " << reproducer->countNodes() << " nodes: "
+	 << diffGenome(reproducer.get(), pool, samples) << "\n"
+	 << "diff-test: reproducer = " << reproducer->toString() << "\n" << std::flush;
+  }
+
+  cout << "diff-test: " << nGenomes << " genomes, " << nFailures << " failed\n";
+  return nFailures;
+}
+
+// A knob that can be set from a config file, or on the command line,
+// as key=value.
+
+struct Setting {
+  string key;
+  function<bool(string const &)> set;
+  function<string()> get;
+};
+
+Setting makeSetting(string const &key, size_t &knob) {
+  return { key,
+	   [&knob](string const &value) {
+	     char *end;
+	     unsigned long long n = strtoull(value.c_str(), &end, 10);
+	     if (value.empty() || value[0] == '-' || *end) {
+	       return false;
+	     }
+	     knob = n;
+	     return true;
+	   },
+	   [&knob]() { return std::to_string(knob); } };
+}
+
+Setting makeSetting(string const &key, long &knob) {
+  return { key,
+	   [&knob](string const &value) {
+	     char *end;
+	     long n = strtol(value.c_str(), &end, 10);
+	     if (value.empty() || *end) {
+	       return false;
+	     }
+	     knob = n;
+	     return true;
+	   },
+	   [&knob]() { return std::to_string(knob); } };
+}
+
+Setting makeSetting(string const &key, int &knob) {
+  return { key,
+	   [&knob](string const &value) {
+	     char *end;
+	     long n = strtol(value.c_str(), &end, 10);
+	     if (value.empty() || *end || n != int(n)) {
+	       return false;
+	     }
+	     knob = n;
+	     return true;
+	   },
+	   [&knob]() { return std::to_string(knob); } };
+}
+
+Setting makeSetting(string const &key, double &knob) {
+  return { key,
+	   [&knob](string const &value) {
+	     char *end;
+	     double d = strtod(value.c_str(), &end);
+	     if (value.empty() || *end) {
+	       return false;
+	     }
+	     knob = d;
+	     return true;
+	   },
+	   [&knob]() {
+	     ostringstream s;
+	     s << knob;
+	     return s.str();
+	   } };
+}
+
+Setting makeSetting(string const &key, bool &knob) {
+  return { key,
+	   [&knob](string const &value) {
+	     if (value == "1" || value == "true" || value == "yes") {
+	       knob = true;
+	     } else if (value == "0" || value == "false" || value == "no") {
+	       knob = false;
+	     } else {
+	       return false;
+	     }
+	     return true;
+	   },
+	   [&knob]() { return string(knob ? "true" : "false"); } };
+}
+
+Setting makeSetting(string const &key, string &knob) {
+  return { key,
+	   [&knob](string const &value) {
+	     knob = value;
+	     return true;
+	   },
+	   [&knob]() { return knob; } };
+}
+
+vector<Setting> makeSettings() {
+  vector<Setting> settings = {
+    makeSetting("seed", fixedSeed),
+    makeSetting("nGenomesPerRun", nGenomesPerRun),
+    makeSetting("nSamplesPerGenome", nSamplesPerGenome),
+    makeSetting("nNetworkInputs", nNetworkInputs),
+    makeSetting("nNetworkOutputs", nNetworkOutputs),
+    makeSetting("randomGenomeNodes", randomGenomeNodes),
+    makeSetting("randomGenomeNodeOdds", randomGenomeNodeOdds),
+    makeSetting("randomGenomeDepth", randomGenomeDepth),
+    makeSetting("randomGenomeDepthOdds", randomGenomeDepthOdds),
+    makeSetting("incrementalEvaluation", incrementalEvaluation),
+    makeSetting("levelEvaluationThreshold", levelEvaluationThreshold),
+    makeSetting("nEvaluationThreads", nEvaluationThreads),
+    makeSetting("compiledEvaluation", compiledEvaluation),
+    makeSetting("compileCommand", compileCommand),
+    makeSetting("compiledNetworkStem", compiledNetworkStem),
+    makeSetting("exportNetworkStem", exportNetworkStem),
+    makeSetting("loadNetworkPath", loadNetworkPath),
+    makeSetting("recursiveTolerance", recursiveTolerance),
+    makeSetting("incrementalTolerance", incrementalTolerance),
+    makeSetting("levelTolerance", levelTolerance),
+    makeSetting("compiledTolerance", compiledTolerance),
+    makeSetting("evolution.nIslands", evolution.nIslands),
+    makeSetting("evolution.populationSize", evolution.populationSize),
+    makeSetting("evolution.nGenerations", evolution.nGenerations),
+    makeSetting("evolution.nElites", evolution.nElites),
+    makeSetting("evolution.tournamentSize", evolution.tournamentSize),
+    makeSetting("evolution.crossoverRate", evolution.crossoverRate),
+    makeSetting("evolution.mutationRate", evolution.mutationRate),
+    makeSetting("evolution.mutationDepth", evolution.mutationDepth),
+    makeSetting("evolution.maxGenomeNodes", evolution.maxGenomeNodes),
+    makeSetting("evolution.nSamples", evolution.nSamples),
+    makeSetting("evolution.gradientSteps", evolution.gradientSteps),
+    makeSetting("evolution.gradientRate", evolution.gradientRate),
+    makeSetting("evolution.paretoSelection", evolution.paretoSelection),
+    makeSetting("evolution.paretoTiming", evolution.paretoTiming),
+    makeSetting("evolution.surrogateScreening", evolution.surrogateScreening),
+    makeSetting("evolution.surrogateQuantile", evolution.surrogateQuantile),
+    makeSetting("evolution.surrogateExploration", evolution.surrogateExploration),
+    makeSetting("evolution.surrogateWarmup", evolution.surrogateWarmup),
+    makeSetting("evolution.surrogateCycles", evolution.surrogateCycles),
+    makeSetting("evolution.memoryReport", evolution.memoryReport),
+    makeSetting("evolution.memoryCeiling", evolution.memoryCeiling),
+    makeSetting("evolution.migrationInterval", evolution.migrationInterval),
+    makeSetting("evolution.migrationSize", evolution.migrationSize),
+    makeSetting("evolution.migrationTopology", evolution.migrationTopology),
+    makeSetting("evolution.migrationSlots", evolution.migrationSlots),
+    makeSetting("evolution.migrationSlotBytes", evolution.migrationSlotBytes),
+  };
+  for (auto k = Ser; k < EoKind; k = GKind(int(k) + 1)) {
+    settings.push_back(makeSetting("randomGenomeLikelihoods." + toString(k), randomGenomeLikelihoods[k]));
+  }
+  return settings;
+}
+
+Setting *findSetting(vector<Setting> &settings, string const &key) {
+  for (auto &setting : settings) {
+    if (setting.key == key) {
+      return &setting;
     }
+  }
+  return 0;
+}
 
-    for (size_t p = 0; p < PNodes.size(); /* empty */) {
-      if (!PNodes[p]->isEvaluated()) {
-	if ((p + 1) < PNodes.size()) {
-	  std::swap(PNodes[p], PNodes.back());
-	}
-	delete PNodes.back();
-	PNodes.pop_back();
-      } else {
-	p += 1;
+bool applySetting(vector<Setting> &settings, string const &key, string const &value) {
+  Setting *setting = findSetting(settings, key);
+  if (!setting) {
+    cerr << "No setting " << key << "\n";
+    return false;
+  }
+  if (!setting->set(value)) {
+    cerr << "Bad value for " << key << ": " << value << "\n";
+    return false;
+  }
+  return true;
+}
+
+string trim(string const &s) {
+  size_t first = s.find_first_not_of(" \t\r");
+  size_t last = s.find_last_not_of(" \t\r");
+  return first == string::npos ? string() : s.substr(first, last - first + 1);
+}
+
+// Reads "key = value" lines, skipping blank lines and # comments.
+
+bool readConfig(string const &path, vector<std::pair<string, string>> &entries) {
+  ifstream in(path.c_str());
+  if (!in) {
+    cerr << "Can't read " << path << "\n";
+    return false;
+  }
+  string line;
+  for (size_t n = 1; std::getline(in, line); n += 1) {
+    line = trim(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    size_t equals = line.find('=');
+    if (equals == string::npos) {
+      cerr << path << ":" << n << ": expected key = value\n";
+      return false;
+    }
+    entries.push_back({ trim(line.substr(0, equals)), trim(line.substr(equals + 1)) });
+  }
+  return true;
+}
+
+// Runs an experiment once for each of a set of configurations, each in
+// a process of its own, nJobs at a time.  Each axis varies one setting
+// over a list of values, "a,b,c", where an integer range, "lo..hi",
+// stands for every integer in it.  A grid sweep runs every combination
+// of the axes' values; a random sweep runs nRandom combinations, each
+// value drawn from its axis's list, or uniformly from its range if
+// that's all the axis has.
+//
+// Each configuration that runs to completion appends a line to the
+// results file, and those already there, with the same seed and
+// settings, are skipped, so a sweep that's stopped picks up where it
+// left off.  Each configuration is seeded with seed plus its index in
+// the sweep.
+
+struct Sweep {
+  vector<std::pair<string, string>> axes;
+  size_t nRandom = 0;
+  size_t nJobs = 1;
+  long seed = 1;
+  string resultsPath = "gp-sweep.results";
+};
+
+bool isInteger(string const &s, long &n) {
+  char *end;
+  n = strtol(s.c_str(), &end, 10);
+  return !s.empty() && !*end;
+}
+
+bool expandAxis(string const &spec, vector<string> &values) {
+  std::istringstream in(spec);
+  string value;
+  while (std::getline(in, value, ',')) {
+    value = trim(value);
+    size_t dots = value.find("..");
+    long lo;
+    long hi;
+    if (dots == string::npos) {
+      values.push_back(value);
+    } else if (isInteger(value.substr(0, dots), lo) && isInteger(value.substr(dots + 2), hi) && lo <= hi) {
+      for (long n = lo; n <= hi; n += 1) {
+	values.push_back(std::to_string(n));
       }
+    } else {
+      return false;
     }
-    for (size_t o = 0; o < ONodes.size(); /* empty */) {
-      if (ONodes[o]->empty()) {
-	if ((o + 1) < ONodes.size()) {
-	  std::swap(ONodes[o], ONodes.back());
-	}
-	delete ONodes.back();
-	ONodes.pop_back();
-      } else {
-	o += 1;
+  }
+  return !values.empty();
+}
+
+bool drawFromAxis(string const &spec, string &value) {
+  size_t dots = spec.find("..");
+  if (spec.find(',') == string::npos && dots != string::npos) {
+    string loValue = trim(spec.substr(0, dots));
+    string hiValue = trim(spec.substr(dots + 2));
+    long lo;
+    long hi;
+    if (isInteger(loValue, lo) && isInteger(hiValue, hi)) {
+      if (hi < lo) {
+	return false;
       }
+      value = std::to_string(lo + long(rand() % (hi - lo + 1)));
+      return true;
+    }
+    char *loEnd;
+    char *hiEnd;
+    double d = strtod(loValue.c_str(), &loEnd);
+    double dHi = strtod(hiValue.c_str(), &hiEnd);
+    if (loValue.empty() || *loEnd || hiValue.empty() || *hiEnd || dHi < d) {
+      return false;
     }
-    for (size_t i = 0; i < INodes.size(); /* empty */) {
-      if (INodes[i]->empty()) {
-	if ((i + 1) < INodes.size()) {
-	  std::swap(INodes[i], INodes.back());
+    d += (dHi - d) * (rand() / (RAND_MAX + 1.0));
+    ostringstream s;
+    s << d;
+    value = s.str();
+    return true;
+  }
+  vector<string> values;
+  if (!expandAxis(spec, values)) {
+    return false;
+  }
+  value = values[rand() % values.size()];
+  return true;
+}
+
+typedef vector<std::pair<string, string>> Configuration;
+
+string toString(Configuration const &configuration) {
+  string s;
+  for (auto &setting : configuration) {
+    s += (s.empty() ? "" : " ") + setting.first + "=" + setting.second;
+  }
+  return s;
+}
+
+bool enumerateSweep(Sweep const &sweep, vector<Configuration> &configurations) {
+  if (sweep.nRandom) {
+    srand(sweep.seed);
+    for (size_t c = 0; c < sweep.nRandom; c += 1) {
+      Configuration configuration;
+      for (auto &axis : sweep.axes) {
+	string value;
+	if (!drawFromAxis(axis.second, value)) {
+	  cerr << "Bad sweep values for " << axis.first << ": " << axis.second << "\n";
+	  return false;
 	}
-	delete INodes.back();
-	INodes.pop_back();
+	configuration.push_back({ axis.first, value });
+      }
+      configurations.push_back(configuration);
+    }
+    return true;
+  }
+
+  vector<vector<string>> values(sweep.axes.size());
+  for (size_t a = 0; a < sweep.axes.size(); a += 1) {
+    if (!expandAxis(sweep.axes[a].second, values[a])) {
+      cerr << "Bad sweep values for " << sweep.axes[a].first << ": " << sweep.axes[a].second << "\n";
+      return false;
+    }
+  }
+
+  // Count through the combinations, the last axis fastest.
+
+  vector<size_t> at(values.size(), 0);
+  for (bool more = true; more; /* empty */) {
+    Configuration configuration;
+    for (size_t a = 0; a < values.size(); a += 1) {
+      configuration.push_back({ sweep.axes[a].first, values[a][at[a]] });
+    }
+    configurations.push_back(configuration);
+
+    more = false;
+    for (size_t a = values.size(); !more && 0 < a--; /* empty */) {
+      if (++at[a] < values[a].size()) {
+	more = true;
       } else {
-	i += 1;
+	at[a] = 0;
       }
     }
+  }
+  return true;
+}
 
-    if (!INodes.empty() && !ONodes.empty() && !PNodes.empty()) {
-      double sumSquaredError = 0.0;
-      for (size_t t = 0; t < 1000; t += 1) {
-	for (auto &i : INodes) {
-	  i->Reset();
-	}
-	for (auto &o : ONodes) {
-	  o->Reset();
-	}
-	for (auto &p : PNodes) {
-	  p->Reset();
-	}
+// A job's key in the results file: its configuration, its seed, and a
+// hash of every other setting that can change its results, so that
+// rerunning a sweep with other fixed settings doesn't skip jobs it
+// hasn't really run, but moving it to another machine, or other scratch
+// paths, does.
 
-	double mean = 0.0;
-	for (auto &i : INodes) {
-	  double value = rand() % 11 - 5;
-	  i->setValue(value);
-	  mean += value;
-	}
-	mean /= INodes.size();
+bool affectsResults(string const &key) {
+  static char const *const incidental[] = {
+    "seed",
+    "nEvaluationThreads",
+    "compiledNetworkStem",
+    "exportNetworkStem",
+    "evolution.memoryReport",
+  };
+  for (auto &i : incidental) {
+    if (key == i) {
+      return false;
+    }
+  }
+  return true;
+}
 
-	for (auto &o : ONodes) {
-	  o->Reset();
-	}
+string jobKey(vector<Setting> const &settings, Configuration const &configuration, long seed) {
+  string everything;
+  for (auto &setting : settings) {
+    if (!affectsResults(setting.key)) {
+      continue;
+    }
+    string value = setting.get();
+    for (auto &swept : configuration) {
+      if (swept.first == setting.key) {
+	value = swept.second;
+      }
+    }
+    everything += setting.key + "=" + value + "\n";
+  }
 
-	char const *comma = "{";
-	for (auto &i : INodes) {
-	  cout << comma << " " << i->Evaluate();
-	  comma = ",";
+  // FNV-1a, which, unlike std::hash, is the same from build to build.
+
+  uint64_t hash = 14695981039346656037ull;
+  for (auto &c : everything) {
+    hash = (hash ^ (unsigned char) c) * 1099511628211ull;
+  }
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) hash);
+
+  return toString(configuration) + "\tseed=" + std::to_string(seed) + "\tsettings=" + hex;
+}
+
+// Runs experiment() for each configuration of the sweep not yet in the
+// results file, with its output going to a log file of its own beside
+// the results.
+
+int runSweep(Sweep const &sweep, vector<Setting> &settings, function<int(double &)> const &experiment) {
+  vector<Configuration> configurations;
+  if (!enumerateSweep(sweep, configurations)) {
+    return 1;
+  }
+
+  vector<string> done;
+  {
+    ifstream in(sweep.resultsPath.c_str());
+    string line;
+    while (std::getline(in, line)) {
+      done.push_back(line);
+    }
+  }
+
+  cout << std::flush;
+  int status = 0;
+  unordered_map<pid_t, size_t> running;
+  auto reap = [&]() {
+    int jobStatus;
+    pid_t pid = wait(&jobStatus);
+    if (pid < 0) {
+      return;
+    }
+    size_t c = running[pid];
+    running.erase(pid);
+    bool ok = WIFEXITED(jobStatus) && WEXITSTATUS(jobStatus) == 0;
+    cout << "sweep: " << (ok ? "finished " : "failed ") << c << ": " << toString(configurations[c]) << "\n" << std::flush;
+    if (!ok) {
+      status = 1;
+    }
+  };
+
+  for (size_t c = 0; c < configurations.size(); c += 1) {
+    string label = toString(configurations[c]);
+    string key = jobKey(settings, configurations[c], sweep.seed + c);
+    auto isDone = [&key](string const &line) { return line.compare(0, key.size() + 1, key + "\t") == 0; };
+    if (std::any_of(done.begin(), done.end(), isDone)) {
+      cout << "sweep: skipping " << c << ": " << label << "\n";
+      continue;
+    }
+    while (sweep.nJobs <= running.size()) {
+      reap();
+    }
+
+    cout << "sweep: starting " << c << ": " << label << "\n" << std::flush;
+    pid_t pid = fork();
+    if (pid == 0) {
+      string logPath = sweep.resultsPath + "." + std::to_string(c) + ".log";
+      int log = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (log < 0 || dup2(log, 1) < 0) {
+	cerr << "sweep: can't write " << logPath << "\n";
+	_exit(1);
+      }
+      close(log);
+
+      fixedSeed = sweep.seed + c;
+      for (auto &setting : configurations[c]) {
+	if (!applySetting(settings, setting.first, setting.second)) {
+	  _exit(1);
 	}
-	cout << " } (" << mean << ") -> ";
-	comma = "{";
-	for (auto &o : ONodes) {
-	  double result = o->Evaluate();
-	  cout << comma << " " << result;
-	  comma = ",";
+      }
 
-	  double error = mean - result;
-	  sumSquaredError += error * error;
+      auto start = std::chrono::steady_clock::now();
+      double bestError = HUGE_VAL;
+      int jobStatus = experiment(bestError);
+      cout << std::flush;
+      if (jobStatus == 0) {
+	ostringstream result;
+	result << key
+	       << "\tbestError=" << bestError
+	       << "\tseconds=" << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+	       << "\n";
+	string line = result.str();
+	int results = open(sweep.resultsPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (results < 0 || write(results, line.data(), line.size()) != ssize_t(line.size())) {
+	  jobStatus = 1;
 	}
-	cout << " }\n";
+	close(results);
       }
-      cout << "sumSquaredError = " << sumSquaredError << "\n\n";
+      _exit(jobStatus);
+    }
+    if (pid < 0) {
+      cerr << "sweep: can't fork\n";
+      status = 1;
+      break;
     }
+    running[pid] = c;
+  }
+  while (!running.empty()) {
+    reap();
+  }
+  return status;
+}
 
-    Dump();
+int main(int argc, char const *argv[]) {
+  size_t nBenchmarkGenomes = 0;
+  size_t nDiffTestGenomes = 0;
+  bool evolve = false;
+  vector<Setting> settings = makeSettings();
+  settings.push_back(makeSetting("evolve", evolve));
+  settings.push_back(makeSetting("nBenchmarkGenomes", nBenchmarkGenomes));
+  settings.push_back(makeSetting("nDiffTestGenomes", nDiffTestGenomes));
+
+  // Settings are applied in order, and a config file's where it's named,
+  // so later ones win.  Those starting "sweep." describe a sweep.
+
+  Sweep sweep;
+  auto configure = [&settings, &sweep](string const &key, string const &value) {
+    if (key.compare(0, 6, "sweep.") != 0) {
+      return applySetting(settings, key, value);
+    }
+    string axis = key.substr(6);
+    if (axis == "jobs") {
+      return makeSetting(key, sweep.nJobs).set(value) && 0 < sweep.nJobs;
+    } else if (axis == "random") {
+      return makeSetting(key, sweep.nRandom).set(value);
+    } else if (axis == "seed") {
+      return makeSetting(key, sweep.seed).set(value);
+    } else if (axis == "results") {
+      return makeSetting(key, sweep.resultsPath).set(value);
+    } else if (!findSetting(settings, axis)) {
+      cerr << "No setting " << axis << " to sweep\n";
+      return false;
+    }
+    sweep.axes.push_back({ axis, value });
+    return true;
+  };
+
+  for (int a = 1; a < argc; a += 1) {
+    string arg(argv[a]);
+    size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 && equals != string::npos) {
+      if (!configure(arg.substr(0, equals), arg.substr(equals + 1))) {
+	return 1;
+      }
+    } else if (arg == "--config" && a + 1 < argc) {
+      vector<std::pair<string, string>> entries;
+      if (!readConfig(argv[++a], entries)) {
+	return 1;
+      }
+      for (auto &entry : entries) {
+	if (!configure(entry.first, entry.second)) {
+	  return 1;
+	}
+      }
+    } else if (arg == "--settings") {
+      for (auto &setting : settings) {
+	cout << setting.key << " = " << setting.get() << "\n";
+      }
+      return 0;
+    } else if (arg == "--compile") {
+      compiledEvaluation = true;
+    } else if (arg == "--export" && a + 1 < argc) {
+      exportNetworkStem = argv[++a];
+    } else if (arg == "--load-network" && a + 1 < argc) {
+      loadNetworkPath = argv[++a];
+    } else if (arg == "--bench-develop" && a + 1 < argc) {
+      nBenchmarkGenomes = strtoul(argv[++a], 0, 10);
+    } else if (arg == "--diff-test" && a + 1 < argc) {
+      nDiffTestGenomes = strtoul(argv[++a], 0, 10);
+    } else if (arg == "--evolve") {
+      evolve = true;
+    } else if (arg == "--islands" && a + 1 < argc) {
+      evolve = true;
+      evolution.nIslands = max(1ul, strtoul(argv[++a], 0, 10));
+    } else if (arg == "--generations" && a + 1 < argc) {
+      evolution.nGenerations = strtoul(argv[++a], 0, 10);
+    } else if (arg == "--population" && a + 1 < argc) {
+      evolution.populationSize = max(1ul, strtoul(argv[++a], 0, 10));
+    } else if (arg == "--surrogate") {
+      evolution.surrogateScreening = true;
+    } else if (arg == "--pareto") {
+      evolution.paretoSelection = true;
+    } else if (arg == "--gradient-steps" && a + 1 < argc) {
+      evolution.gradientSteps = strtoul(argv[++a], 0, 10);
+    } else if (arg == "--migration" && a + 3 < argc) {
+      evolution.migrationInterval = strtoul(argv[++a], 0, 10);
+      evolution.migrationSize = strtoul(argv[++a], 0, 10);
+      evolution.migrationTopology = argv[++a];
+    } else {
+      cerr << "Usage: " << argv[0] << " [--config <file>] [<key>=<value> ...] [--settings]\n"
+	   << "    [--compile] [--export <stem>] [--load-network <file.so>]\n"
+	   << "    [--bench-develop <n>] [--diff-test <n>]\n"
+	   << "    [--evolve] [--islands <n>] [--generations <n>] [--population <n>]\n"
+	   << "    [--gradient-steps <n>] [--pareto] [--surrogate]\n"
+	   << "    [--migration <interval> <size> ring|complete|random]\n"
+	   << "  Sweeps are set with sweep.<key>=<a>,<b>,...|<lo>..<hi>, sweep.random=<n>,\n"
+	   << "  sweep.jobs=<n>, sweep.seed=<n> and sweep.results=<file>.\n";
+      return 1;
+    }
   }
 
-  return 0;
+  auto experiment = [&evolve, &nBenchmarkGenomes, &nDiffTestGenomes](double &bestError) {
+    int seed = time(0);
+    if (0 <= fixedSeed) {
+      seed = fixedSeed;
+    }
+    cout << "Seed = " << seed << "\n", srand(seed);
+
+    if (nBenchmarkGenomes) {
+      benchmarkDevelopment(nBenchmarkGenomes);
+      return 0;
+    }
+    if (nDiffTestGenomes) {
+      return runDiffTest(seed, nDiffTestGenomes) ? 1 : 0;
+    }
+    if (!loadNetworkPath.empty()) {
+      return runLoadedNetwork(bestError);
+    }
+    if (evolve) {
+      return runIslands(seed, bestError);
+    }
+
+    WorkerPool workerPool(nEvaluationThreads);
+    bestError = runGenomes(workerPool);
+    return 0;
+  };
+
+  if (!sweep.axes.empty()) {
+    if (0 <= fixedSeed) {
+      cerr << "A sweep seeds each job from sweep.seed; set that rather than seed\n";
+      return 1;
+    }
+    return runSweep(sweep, settings, experiment);
+  }
+  double bestError;
+  return experiment(bestError);
 }